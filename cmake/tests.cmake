@@ -12,8 +12,9 @@ FOREACH(TEST_FULL_PATH ${POSE_TESTS})
 
     MESSAGE(STATUS ">>> To build [TEST]: ${TEST_FULL_PATH} --> ${TEST_TAR}")
 
-    ADD_EXECUTABLE(${TEST_TAR} ${TEST_FULL_PATH} src/thread_pool.cpp)
+    ADD_EXECUTABLE(${TEST_TAR} ${TEST_FULL_PATH} src/logging.cpp src/thread_pool.cpp)
     TARGET_LINK_LIBRARIES(${TEST_TAR} helpers)
+    TARGET_INCLUDE_DIRECTORIES(${TEST_TAR} PRIVATE ${CMAKE_SOURCE_DIR}/src)
     SET_PROPERTY(TARGET ${TEST_TAR} PROPERTY COMPILE_FLAGS "")
     ADD_TEST(NAME ${TEST_TAR} COMMAND ${TEST_TAR})
 ENDFOREACH()
@@ -32,6 +32,7 @@ DEFINE_string(saving_prefix, "output", "The output media resource will be named
 
 // System Configuration
 DEFINE_bool(logging, false, "Print the logging information or not.");
+DEFINE_bool(warm_up, true, "Run the engine and the parser on a dummy batch before the first frame. (stream runtime)");
 
 namespace hp = hyperpose;
 
@@ -42,6 +43,10 @@ public:
     {
         return std::visit([&feature_map_containers](auto& arg) { return arg.process(feature_map_containers); }, m_parser);
     }
+    std::vector<std::vector<hp::human_t>> process_batch(std::vector<hp::internal_t>& batch)
+    {
+        return std::visit([&batch](auto& arg) { return arg.process_batch(batch); }, m_parser);
+    }
     parser_variant(std::variant<hp::parser::pose_proposal, hp::parser::paf> v)
         : m_parser(std::move(v))
     {
@@ -279,6 +284,9 @@ int main(int argc, char** argv)
         auto stream = hp::make_stream(engine, parser, true, FLAGS_keep_ratio);
         auto writer = make_writer();
 
+        if (FLAGS_warm_up)
+            cli_log() << "Warmed up the stream in " << stream.warm_up() << " ms\n";
+
         auto beg = clk_t::now();
 
         stream.add_monitor(2000);
@@ -289,6 +297,7 @@ int main(int argc, char** argv)
         auto millis = std::chrono::duration<double, std::milli>(clk_t::now() - beg).count();
 
         std::cout << stream.processed_num() << " images got processed in " << millis << " ms, FPS = "
-                  << 1000. * stream.processed_num() / millis << '\n';
+                  << 1000. * stream.processed_num() / millis << ", first frame latency = "
+                  << stream.first_frame_latency() << " ms\n";
     }
 }
\ No newline at end of file
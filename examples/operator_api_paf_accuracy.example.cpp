@@ -0,0 +1,141 @@
+#include "utils.hpp"
+#include <gflags/gflags.h>
+#include <hyperpose/hyperpose.hpp>
+#include <cmath>
+#include <limits>
+#include <string_view>
+
+// Model flags
+DEFINE_string(model_file, "../data/models/TinyVGG-V1-HW=256x384.uff", "Path to uff model.");
+
+DEFINE_bool(logging, false, "Print the logging information or not.");
+
+DEFINE_string(input_name, "image", "The input node name of your model file. (for Uff model, input/output name tags required)");
+DEFINE_string(output_name_list, "outputs/conf,outputs/paf", "The output node names(maybe more than one) of your uff model file.");
+
+DEFINE_int32(input_height, 256, "Height of input image.");
+DEFINE_int32(input_width, 384, "Width of input image.");
+
+DEFINE_string(input_folder, "../data/media", "Folder of images to inference.");
+
+DEFINE_bool(native_paf_sampling, false, "Also sample the PAF map at its original resolution in the native mode.");
+DEFINE_double(match_distance, 10, "Max mean key point distance (in input image pixels) to match two humans.");
+
+namespace hp = hyperpose;
+
+// Mean distance of the key points both humans have, in input image pixels. (infinity if there is none)
+static double mean_distance(const hp::human_t& a, const hp::human_t& b)
+{
+    double sum = 0;
+    int n = 0;
+    for (size_t i = 0; i < a.parts.size(); ++i)
+        if (a.parts[i].has_value && b.parts[i].has_value) {
+            sum += std::hypot((a.parts[i].x - b.parts[i].x) * FLAGS_input_width, (a.parts[i].y - b.parts[i].y) * FLAGS_input_height);
+            ++n;
+        }
+    return n == 0 ? std::numeric_limits<double>::infinity() : sum / n;
+}
+
+// Compare the native resolution peak finding (`paf::set_native_resolution_peak_finding`) with the default 4x
+// upsampled one on the same feature maps.
+int main(int argc, char** argv)
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::vector<cv::Mat> batch = glob_images(FLAGS_input_folder);
+
+    if (batch.empty()) {
+        example_log() << "No input images got. Exiting.\n";
+        exit(-1);
+    }
+
+    if (FLAGS_logging)
+        hp::enable_logging();
+
+    auto engine = [&] {
+        using namespace hp::dnn;
+        constexpr std::string_view onnx_suffix = ".onnx";
+        constexpr std::string_view uff_suffix = ".uff";
+
+        if (std::equal(onnx_suffix.crbegin(), onnx_suffix.crend(), FLAGS_model_file.crbegin()))
+            return tensorrt(onnx{ FLAGS_model_file }, { FLAGS_input_width, FLAGS_input_height }, batch.size());
+
+        if (std::equal(uff_suffix.crbegin(), uff_suffix.crend(), FLAGS_model_file.crbegin()))
+            return tensorrt(
+                uff{ FLAGS_model_file, FLAGS_input_name, split(FLAGS_output_name_list, ',') },
+                { FLAGS_input_width, FLAGS_input_height },
+                batch.size());
+
+        example_log() << "Your model file's suffix is not [.onnx | .uff]. Your model file path: " << FLAGS_model_file;
+        example_log() << "Trying to be viewed as a serialized TensorRT model.";
+
+        return tensorrt(tensorrt_serialized{ FLAGS_model_file }, { FLAGS_input_width, FLAGS_input_height }, batch.size());
+    }();
+
+    hp::parser::paf upsampled{}, native{};
+    native.set_native_resolution_peak_finding(true);
+    native.set_native_resolution_paf_sampling(FLAGS_native_paf_sampling);
+
+    const auto feature_map_packets = engine.inference(batch);
+
+    using clk_t = std::chrono::high_resolution_clock;
+    double upsampled_ms = 0, native_ms = 0;
+
+    size_t n_upsampled = 0, n_native = 0, n_matched = 0;
+    size_t n_parts = 0, n_parts_only_upsampled = 0, n_parts_only_native = 0;
+    double distance_sum = 0, distance_max = 0;
+
+    for (auto&& packet : feature_map_packets) {
+        auto beg = clk_t::now();
+        const auto reference = upsampled.process(packet[0], packet[1]);
+        upsampled_ms += std::chrono::duration<double, std::milli>(clk_t::now() - beg).count();
+
+        beg = clk_t::now();
+        const auto humans = native.process(packet[0], packet[1]);
+        native_ms += std::chrono::duration<double, std::milli>(clk_t::now() - beg).count();
+
+        n_upsampled += reference.size();
+        n_native += humans.size();
+
+        // Greedy matching by mean key point distance.
+        std::vector<bool> used(humans.size(), false);
+        for (const auto& ref : reference) {
+            int best = -1;
+            double best_distance = FLAGS_match_distance;
+            for (size_t i = 0; i < humans.size(); ++i) {
+                const double d = mean_distance(ref, humans[i]);
+                if (!used[i] && d <= best_distance) {
+                    best = i;
+                    best_distance = d;
+                }
+            }
+            if (best < 0)
+                continue;
+
+            used[best] = true;
+            ++n_matched;
+            for (size_t i = 0; i < ref.parts.size(); ++i) {
+                const auto &a = ref.parts[i], &b = humans[best].parts[i];
+                if (a.has_value && b.has_value) {
+                    const double d = std::hypot((a.x - b.x) * FLAGS_input_width, (a.y - b.y) * FLAGS_input_height);
+                    distance_sum += d;
+                    distance_max = std::max(distance_max, d);
+                    ++n_parts;
+                } else if (a.has_value) {
+                    ++n_parts_only_upsampled;
+                } else if (b.has_value) {
+                    ++n_parts_only_native;
+                }
+            }
+        }
+    }
+
+    const size_t n_images = feature_map_packets.size();
+    std::cout << n_images << " images got processed.\n"
+              << "Parsing time per image:\tupsampled = " << upsampled_ms / n_images << " ms, native = " << native_ms / n_images << " ms\n"
+              << "Humans:\tupsampled = " << n_upsampled << ", native = " << n_native << ", matched = " << n_matched << '\n'
+              << "Key points of matched humans:\tboth = " << n_parts << ", only upsampled = " << n_parts_only_upsampled
+              << ", only native = " << n_parts_only_native << '\n'
+              << "Key point distance (input image pixels):\tmean = " << (n_parts ? distance_sum / n_parts : 0.)
+              << ", max = " << distance_max << '\n';
+}
@@ -0,0 +1,79 @@
+#include "gaussian_blur.hpp"
+#include "test_utility.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+static cv::Mat make_heatmap(int height, int width, int n_blobs)
+{
+    cv::Mat image(height, width, CV_32F);
+    std::mt19937 gen(height * 131 + width);
+    random_heatmap(image.ptr<float>(), height, width, n_blobs, gen);
+    return image;
+}
+
+// Compare both smoothing engines to cv::GaussianBlur(ksize = 17, sigma = 3), as used by the PAF parser.
+static bool test_once(int height, int width, int loop_tms)
+{
+    constexpr int ksize = 17;
+    constexpr double sigma = 3;
+
+    const cv::Mat input = make_heatmap(height, width, 10);
+    cv::Mat expected, separable(height, width, CV_32F), recursive(height, width, CV_32F);
+
+    const std::string shape = "[" + std::to_string(height) + ", " + std::to_string(width) + "]";
+
+    bench([&] { cv::GaussianBlur(input, expected, cv::Size(ksize, ksize), sigma); },
+        "cv::GaussianBlur\t" + shape, loop_tms);
+
+    const auto kernel = hyperpose::gaussian_kernel(ksize, sigma);
+    hyperpose::gaussian_row_cache cache;
+    bench([&] { hyperpose::separable_gaussian_blur_2d(height, width, input.ptr<float>(), separable.ptr<float>(), kernel, cache); },
+        std::string("Separable(") + hyperpose::simd::isa + ") Gaussian\t" + shape, loop_tms);
+
+    const auto coefficients = hyperpose::young_van_vliet(sigma);
+    std::vector<float> line;
+    bench([&] { hyperpose::recursive_gaussian_blur_2d(height, width, input.ptr<float>(), recursive.ptr<float>(), coefficients, line); },
+        std::string("Recursive(") + hyperpose::simd::isa + ") Gaussian\t" + shape, loop_tms);
+
+    double max_value;
+    cv::minMaxLoc(expected, nullptr, &max_value);
+
+    // The separable filter computes the same sums in a different order.
+    const double separable_error = cv::norm(separable, expected, cv::NORM_INF);
+    // The recursive filter approximates an untruncated Gaussian and extends borders with the edge value.
+    const double recursive_error = cv::norm(recursive, expected, cv::NORM_INF);
+    const int margin = 3 * sigma;
+    const cv::Rect interior(margin, margin, std::max(width - 2 * margin, 0), std::max(height - 2 * margin, 0));
+    const double recursive_interior_error = interior.area() == 0 ? 0 : cv::norm(recursive(interior), expected(interior), cv::NORM_INF);
+
+    std::cout << "Max error\t" << shape << ": separable = " << separable_error / max_value
+              << ", recursive = " << recursive_error / max_value
+              << ", recursive(interior) = " << recursive_interior_error / max_value << " (relative to max value)\n";
+
+    bool ok = true;
+    if (separable_error > 1e-5 * max_value) {
+        std::cerr << "[TEST FAILED] Separable Gaussian mismatches cv::GaussianBlur @ " << shape << std::endl;
+        ok = false;
+    }
+    if (recursive_error > 0.15 * max_value || recursive_interior_error > 0.04 * max_value) {
+        std::cerr << "[TEST FAILED] Recursive Gaussian is out of tolerance @ " << shape << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+
+    ok &= test_once(128, 192, 20);
+    ok &= test_once(184, 368, 20);
+    ok &= test_once(23, 37, 1);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+#include "human_assembly.hpp"
+#include "test_utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace hyperpose;
+
+struct peak {
+    float score;
+};
+
+template <typename Topology>
+using human_ref = human_ref_t_<Topology::n_parts>;
+
+// Reference implementation: scans all the humans for each connection, and flags the merged humans instead of erasing
+// them, so that the ids stay the indices of the humans.
+template <typename Topology>
+static std::vector<human_ref<Topology>> reference_get_humans(const std::vector<peak>& all_peaks,
+    const std::vector<std::vector<connection>>& all_connections)
+{
+    std::vector<human_ref<Topology>> human_refs;
+    std::vector<bool> merged;
+    for (size_t pair_id = 0; pair_id < Topology::limbs.size(); pair_id++) {
+        const limb_t& limb = Topology::limbs[pair_id];
+        const int part_id1 = limb.part1;
+        const int part_id2 = limb.part2;
+
+        for (const connection& conn : all_connections[pair_id]) {
+            std::vector<int> hr_ids;
+            for (const auto& hr : human_refs)
+                if (!merged[hr.id] && (hr.parts[part_id1].id == conn.cid1 || hr.parts[part_id2].id == conn.cid2))
+                    hr_ids.push_back(hr.id);
+
+            if (hr_ids.size() == 1) {
+                auto& hr1 = human_refs[hr_ids[0]];
+                if (hr1.parts[part_id2].id != conn.cid2) {
+                    hr1.parts[part_id2].id = conn.cid2;
+                    ++hr1.n_parts;
+                    hr1.score += all_peaks[conn.cid2].score + conn.score;
+                }
+            } else if (hr_ids.size() >= 2) {
+                auto& hr1 = human_refs[hr_ids[0]];
+                auto& hr2 = human_refs[hr_ids[1]];
+
+                bool membership = false;
+                for (int i = 0; i < Topology::n_parts; ++i)
+                    if (hr1.parts[i].id >= 0 && hr2.parts[i].id >= 0)
+                        membership = true;
+
+                if (!membership) {
+                    for (int i = 0; i < Topology::n_parts; i++)
+                        if (hr2.parts[i].id >= 0)
+                            hr1.parts[i].id = hr2.parts[i].id;
+
+                    hr1.n_parts += hr2.n_parts;
+                    hr1.score += hr2.score;
+                    hr1.score += conn.score;
+
+                    merged[hr2.id] = true;
+                } else {
+                    hr1.parts[part_id2].id = conn.cid2;
+                    hr1.n_parts += 1;
+                    hr1.score += all_peaks[conn.cid2].score + conn.score;
+                }
+            } else if (hr_ids.empty() && !limb.is_virtual) {
+                human_ref<Topology> h;
+                h.parts[part_id1].id = conn.cid1;
+                h.parts[part_id2].id = conn.cid2;
+                h.n_parts = 2;
+                h.score = all_peaks[conn.cid1].score + all_peaks[conn.cid2].score + conn.score;
+                h.id = human_refs.size();
+
+                human_refs.push_back(h);
+                merged.push_back(false);
+            }
+        }
+    }
+
+    std::vector<human_ref<Topology>> ret;
+    for (const auto& hr : human_refs)
+        if (!merged[hr.id] && hr.n_parts >= parser::THRESH_PART_CNT && hr.score / hr.n_parts >= parser::THRESH_HUMAN_SCORE)
+            ret.push_back(hr);
+    return ret;
+}
+
+template <typename Topology>
+static bool same_humans(const std::vector<human_ref<Topology>>& l, const std::vector<human_ref<Topology>>& r)
+{
+    if (l.size() != r.size())
+        return false;
+    for (size_t h = 0; h < l.size(); ++h) {
+        if (l[h].id != r[h].id || l[h].n_parts != r[h].n_parts || l[h].score != r[h].score)
+            return false;
+        for (int i = 0; i < Topology::n_parts; ++i)
+            if (l[h].parts[i].id != r[h].parts[i].id)
+                return false;
+    }
+    return true;
+}
+
+// The assembler must give the same humans as the reference on random connections: `n_people` peaks per part, where
+// each limb connects a random subset of them, each peak at most once (as `select_connections` does). Peak `k` of part
+// `i` has id `i * n_people + k`, so the peak id 0 is used.
+template <typename Topology>
+static bool test_once(const std::string& name, int n_people, int seed, int loop_tms)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, 1);
+
+    std::vector<peak> all_peaks(Topology::n_parts * n_people);
+    for (auto& p : all_peaks)
+        p.score = dist(gen);
+
+    std::vector<std::vector<connection>> all_connections(Topology::limbs.size());
+    std::vector<int> from(n_people), to(n_people);
+    for (size_t pair_id = 0; pair_id < Topology::limbs.size(); ++pair_id) {
+        const limb_t& limb = Topology::limbs[pair_id];
+        std::iota(from.begin(), from.end(), 0);
+        std::iota(to.begin(), to.end(), 0);
+        std::shuffle(from.begin(), from.end(), gen);
+        std::shuffle(to.begin(), to.end(), gen);
+        for (int k = 0; k < n_people; ++k)
+            if (dist(gen) < 0.8) {
+                const int id1 = limb.part1 * n_people + from[k], id2 = limb.part2 * n_people + to[k];
+                all_connections[pair_id].push_back(connection{ id1, id2, dist(gen), id1, id2 });
+            }
+    }
+
+    const std::string shape = name + ", n_people = " + std::to_string(n_people) + ", seed = " + std::to_string(seed);
+
+    std::vector<human_ref<Topology>> expected, actual;
+    bench([&] { expected = reference_get_humans<Topology>(all_peaks, all_connections); }, "Reference Assembly\t" + shape, loop_tms);
+    bench([&] { actual = parser::get_humans<Topology>(all_peaks, all_connections); }, "Union-find Assembly\t" + shape, loop_tms);
+
+    if (!same_humans<Topology>(expected, actual)) {
+        std::cerr << "[TEST FAILED] Human assembly mismatches the reference @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// 6 key points, connected as 3 separate limbs first, then bridged one after another.
+struct chain_topology {
+    static constexpr int n_parts = 6;
+    static constexpr std::array<limb_t, 5> limbs = { {
+        { 0, 1, 0, 1 },
+        { 2, 3, 2, 3 },
+        { 4, 5, 4, 5 },
+        { 1, 2, 6, 7 },
+        { 3, 4, 8, 9 },
+    } };
+};
+
+// The humans {0, 1}, {2, 3}, {4, 5} are merged into the first one by a chain: {2, 3} by the limb 1 -> 2, then {4, 5}
+// by the limb 3 -> 4, whose peak 3 belongs to the already merged human. The peak ids are the part ids.
+static bool test_merge_chain()
+{
+    const std::vector<peak> all_peaks(chain_topology::n_parts, peak{ 1 });
+    std::vector<std::vector<connection>> all_connections(chain_topology::limbs.size());
+    for (size_t pair_id = 0; pair_id < chain_topology::limbs.size(); ++pair_id) {
+        const limb_t& limb = chain_topology::limbs[pair_id];
+        all_connections[pair_id].push_back(connection{ limb.part1, limb.part2, 1, limb.part1, limb.part2 });
+    }
+
+    const auto humans = parser::get_humans<chain_topology>(all_peaks, all_connections);
+    bool ok = humans.size() == 1 && humans[0].id == 0 && humans[0].n_parts == 6;
+    for (int i = 0; ok && i < chain_topology::n_parts; ++i)
+        ok = humans[0].parts[i].id == i;
+
+    if (!ok || !same_humans<chain_topology>(humans, reference_get_humans<chain_topology>(all_peaks, all_connections))) {
+        std::cerr << "[TEST FAILED] Chained merges are not assembled into one human" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 3 key points: the humans {0: peak 0, 1: peak 1} and {0: peak 2, 2: peak 3} both have the key point 0, so the limb
+// 1 -> 2 joining them must not merge them, though one of them holds the peak id 0.
+struct fork_topology {
+    static constexpr int n_parts = 3;
+    static constexpr std::array<limb_t, 3> limbs = { {
+        { 0, 1, 0, 1 },
+        { 0, 2, 2, 3 },
+        { 1, 2, 4, 5 },
+    } };
+};
+
+static bool test_peak_id_zero()
+{
+    const std::vector<peak> all_peaks(4, peak{ 1 });
+    const std::vector<std::vector<connection>> all_connections = {
+        { connection{ 0, 1, 1, 0, 1 } },
+        { connection{ 2, 3, 1, 2, 3 } },
+        { connection{ 1, 3, 1, 1, 3 } },
+    };
+
+    // Not merged, the first human only takes the peak 3 as its key point 2: both have less than `THRESH_PART_CNT` key
+    // points and are dropped. (Merged, they would be one human of 4 key points.)
+    const auto humans = parser::get_humans<fork_topology>(all_peaks, all_connections);
+    if (humans.size() != 0 || !same_humans<fork_topology>(humans, reference_get_humans<fork_topology>(all_peaks, all_connections))) {
+        std::cerr << "[TEST FAILED] Humans sharing the key point of the peak id 0 are merged" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_merge_chain();
+    ok &= test_peak_id_zero();
+    ok &= test_once<coco_topology>("COCO", 1, 0, 1);
+
+    // Random connections, with merges (and chains of them) between the partial humans.
+    for (int seed = 0; seed < 200; ++seed)
+        ok &= test_once<coco_topology>("COCO", 1 + seed % 8, seed, 1);
+    for (int seed = 0; seed < 50; ++seed)
+        ok &= test_once<body25_topology>("BODY25", 1 + seed % 8, seed, 1);
+
+    // Crowds.
+    for (int n_people : { 20, 50 })
+        ok &= test_once<coco_topology>("COCO", n_people, n_people, 10);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include "max_pool.hpp"
+#include "test_utility.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compare the SIMD max pooling against the scalar reference and time both.
+// Values are quantized so that plateaus (equal neighbours) are frequent.
+static bool test_once(int channel, int height, int width, int loop_tms)
+{
+    const size_t size = size_t(channel) * height * width;
+    std::vector<float> input(size), expected(size), actual(size), column_max(width);
+
+    std::mt19937 gen(height * 131 + width);
+    std::uniform_int_distribution<int> dist(-8, 64);
+    for (auto& v : input)
+        v = dist(gen) / 64.f;
+
+    const std::string shape = "[" + std::to_string(channel) + ", " + std::to_string(height) + ", " + std::to_string(width) + "]";
+
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k)
+                hyperpose::same_max_pool_3x3_2d(height, width, input.data() + k * height * width, expected.data() + k * height * width);
+        },
+        "Scalar 3x3 Max Pool\t" + shape, loop_tms);
+
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k)
+                hyperpose::same_max_pool_3x3_2d_simd(height, width, input.data() + k * height * width, actual.data() + k * height * width, column_max.data());
+        },
+        std::string("SIMD(") + hyperpose::simd::isa + ") 3x3 Max Pool\t" + shape, loop_tms);
+
+    if (std::memcmp(expected.data(), actual.data(), size * sizeof(float)) != 0) {
+        std::cerr << "[TEST FAILED] SIMD max pooling mismatches the scalar version @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_once(1, 1, 1, 1);
+    ok &= test_once(1, 1, 17, 1);
+    ok &= test_once(1, 17, 1, 1);
+    ok &= test_once(2, 3, 9, 1);
+
+    // Typical 4x upsampled OpenPose feature maps.
+    ok &= test_once(19, 128, 192, 20);
+    ok &= test_once(19, 184, 368, 20);
+
+    return ok ? 0 : 1;
+}
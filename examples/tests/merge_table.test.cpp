@@ -0,0 +1,160 @@
+#include "merge_table.hpp"
+#include "test_utility.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace hyperpose;
+
+static bool same_key_point(const body_part_t& l, const body_part_t& r)
+{
+    return l.has_value && r.has_value && l.x == r.x && l.y == r.y;
+}
+
+// Reference implementation: for each key point of each human, scans the humans before it for one holding the key point.
+static size_t reference_merge_humans(std::vector<human_t>& humans, const size_t n_key_points)
+{
+    std::vector<bool> registered(humans.size(), false), merged(humans.size(), false);
+    size_t n_merged = 0;
+    for (size_t i = 0; i < humans.size(); ++i) {
+        auto& cur_human = humans[i];
+        if (cur_human.score > n_key_points - 0.1)
+            continue;
+        registered[i] = true;
+
+        for (size_t j = 0; j < cur_human.parts.size() && !merged[i]; ++j) {
+            for (size_t h = 0; h < i; ++h) {
+                if (!registered[h] || merged[h] || !same_key_point(humans[h].parts[j], cur_human.parts[j]))
+                    continue;
+
+                for (size_t u = 0; u < cur_human.parts.size(); ++u)
+                    if (cur_human.parts[u].has_value && !humans[h].parts[u].has_value) {
+                        humans[h].parts[u] = cur_human.parts[u];
+                        humans[h].score += 1.0;
+                    }
+
+                cur_human.score = 0;
+                merged[i] = true;
+                ++n_merged;
+                break;
+            }
+        }
+    }
+    return n_merged;
+}
+
+static bool same_humans(const std::vector<human_t>& l, const std::vector<human_t>& r)
+{
+    for (size_t h = 0; h < l.size(); ++h) {
+        if (l[h].score != r[h].score)
+            return false;
+        for (size_t i = 0; i < l[h].parts.size(); ++i)
+            if (l[h].parts[i].has_value != r[h].parts[i].has_value || l[h].parts[i].x != r[h].parts[i].x || l[h].parts[i].y != r[h].parts[i].y)
+                return false;
+    }
+    return l.size() == r.size();
+}
+
+static human_t make_human(const std::vector<std::pair<int, float>>& parts)
+{
+    human_t human{};
+    human.score = 0;
+    for (const auto& [part, x] : parts) {
+        human.parts[part] = body_part_t{ true, x, 0.5, 1 };
+        human.score += 1.0;
+    }
+    return human;
+}
+
+// A merged human's key points are only found for the human it's merged into if that human takes them.
+// B shares a3 with A and merges into it, but A keeps a1 rather than B's b1, and takes b4. Then C, which shares only b1
+// with B, stays apart, and D, which shares b4, merges into A.
+static bool test_not_taken_key_points()
+{
+    const float a1 = 0.1, a3 = 0.3, b1 = 0.15, b4 = 0.45, c6 = 0.6;
+    std::vector<human_t> humans = {
+        make_human({ { 1, a1 }, { 3, a3 } }), // A
+        make_human({ { 1, b1 }, { 3, a3 }, { 4, b4 } }), // B
+        make_human({ { 1, b1 }, { 6, c6 } }), // C
+        make_human({ { 4, b4 } }), // D
+    };
+    auto expected = humans;
+    reference_merge_humans(expected, COCO_N_PARTS);
+
+    merge_table table;
+    const size_t n_merged = merge_humans(humans, table, COCO_N_PARTS);
+
+    const bool ok = n_merged == 2 && humans[1].score == 0 && humans[2].score == 2 && humans[3].score == 0
+        && humans[0].score == 3 && humans[0].parts[1].x == a1 && !humans[0].parts[6].has_value;
+    if (!ok || !same_humans(expected, humans)) {
+        std::cerr << "[TEST FAILED] Humans are merged through key points not taken by the human merged into" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The table must merge the same humans as the reference: `n_humans` partial humans of `n_parts` key points each, taken
+// from `n_positions` positions per part type, so that many of them share key points.
+static bool test_once(int n_humans, int n_parts, int n_positions, int loop_tms)
+{
+    std::mt19937 gen(n_humans * 131 + n_parts * 17 + n_positions);
+    std::uniform_int_distribution<int> part(0, COCO_N_PARTS - 1), position(0, n_positions - 1);
+    std::vector<human_t> humans(n_humans);
+    for (auto& human : humans) {
+        human = human_t{};
+        human.score = 0;
+        for (int k = 0; k < n_parts; ++k) {
+            auto& p = human.parts[part(gen)];
+            if (!p.has_value)
+                human.score += 1.0;
+            p = body_part_t{ true, (position(gen) + 0.5f) / n_positions, (position(gen) + 0.5f) / n_positions, 1 };
+        }
+    }
+
+    const std::string shape = "n_humans = " + std::to_string(n_humans) + ", n_parts = " + std::to_string(n_parts)
+        + ", n_positions = " + std::to_string(n_positions);
+
+    std::vector<human_t> expected, actual;
+    size_t expected_merged = 0, actual_merged = 0;
+    bench(
+        [&] {
+            expected = humans;
+            expected_merged = reference_merge_humans(expected, COCO_N_PARTS);
+        },
+        "Linear Scan Merging\t" + shape, loop_tms);
+
+    merge_table table;
+    bench(
+        [&] {
+            actual = humans;
+            actual_merged = merge_humans(actual, table, COCO_N_PARTS);
+        },
+        "Merge Table Merging\t" + shape, loop_tms);
+
+    if (expected_merged != actual_merged || !same_humans(expected, actual)) {
+        std::cerr << "[TEST FAILED] Merge table mismatches the linear scan @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_not_taken_key_points();
+    ok &= test_once(0, 2, 4, 1);
+    ok &= test_once(1, 2, 4, 1);
+    ok &= test_once(20, COCO_N_PARTS * 4, 2, 1); // (Mostly) complete humans, which are never merged.
+
+    // Crowds of partial humans sharing key points.
+    for (int n_humans : { 10, 100, 1000 })
+        for (int n_positions : { 2, 4, 8 })
+            ok &= test_once(n_humans, 3, n_positions, 3);
+
+    return ok ? 0 : 1;
+}
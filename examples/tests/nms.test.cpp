@@ -0,0 +1,82 @@
+#include "nms.hpp"
+#include "test_utility.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Reference implementation: greedy NMS over boxes sorted by confidence (descending), one pair at a time.
+static std::vector<bool> greedy_nms(const std::vector<cv::Rect>& boxes, float thresh)
+{
+    std::vector<bool> suppressed(boxes.size(), false);
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (suppressed[i])
+            continue;
+        for (size_t j = i + 1; j < boxes.size(); ++j) {
+            const float inter = (boxes[i] & boxes[j]).area();
+            const float uni = boxes[i].area() + boxes[j].area() - inter;
+            if (uni > 0 && inter >= thresh * uni)
+                suppressed[j] = true;
+        }
+    }
+    return suppressed;
+}
+
+// The SIMD suppression mask must keep exactly the boxes the greedy NMS keeps.
+// Boxes sit on a `step` pixel lattice with sizes in multiples of `step`, so identical boxes and IoUs equal to the
+// threshold (e.g., 0.5, 0.25) are frequent. `step` = 1 gives arbitrary boxes, some of them empty.
+static bool test_once(int n, int resolution, int step, float thresh, int loop_tms)
+{
+    std::mt19937 gen(n * 131 + step);
+    std::uniform_int_distribution<int> pos(0, resolution / step - 1), size(step == 1 ? 0 : 1, step == 1 ? 32 : 4);
+    std::vector<cv::Rect> boxes(n);
+    for (auto& b : boxes)
+        b = cv::Rect(pos(gen) * step, pos(gen) * step, size(gen) * step, size(gen) * step);
+
+    const std::string shape = "n = " + std::to_string(n) + ", step = " + std::to_string(step) + ", thresh = " + std::to_string(thresh);
+
+    std::vector<bool> expected;
+    bench([&] { expected = greedy_nms(boxes, thresh); }, "Greedy NMS\t" + shape, loop_tms);
+
+    hyperpose::nms_boxes soa;
+    bench(
+        [&] {
+            soa.assign(n);
+            for (int i = 0; i < n; ++i)
+                soa.set(i, boxes[i]);
+            soa.suppress(n, thresh);
+        },
+        "SIMD Suppression Mask NMS\t" + shape, loop_tms);
+
+    for (int i = 0; i < n; ++i)
+        if (expected[i] != (soa.suppressed[i] != 0.f)) {
+            std::cerr << "[TEST FAILED] NMS mismatches the greedy NMS at box " << i << " @ " << shape << std::endl;
+            return false;
+        }
+
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_once(0, 384, 1, 0.3, 1);
+    ok &= test_once(1, 384, 1, 0.3, 1);
+    ok &= test_once(7, 384, 1, 0.3, 1); // Fewer boxes than one SIMD width.
+    ok &= test_once(100, 16, 1, 0, 1); // Every overlapping box is suppressed.
+    ok &= test_once(100, 16, 1, 1, 1); // Only the identical boxes are suppressed.
+
+    // Ties: identical boxes and IoUs equal to the threshold.
+    for (float thresh : { 0.25f, 0.5f })
+        ok &= test_once(2000, 64, 8, thresh, 1);
+
+    // Thousands of boxes, low thresholds.
+    for (int n : { 1000, 5000 })
+        for (float thresh : { 0.05f, 0.1f, 0.3f, 0.6f })
+            ok &= test_once(n, 384, 1, thresh, 3);
+
+    return ok ? 0 : 1;
+}
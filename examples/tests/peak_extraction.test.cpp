@@ -0,0 +1,282 @@
+#include "peak_extraction.hpp"
+#include "test_utility.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The fused smooth -> pool -> threshold pass must find exactly the peaks of the three separate passes.
+static bool test_once(int channel, int height, int width, int loop_tms)
+{
+    constexpr float threshold = 0.05;
+    const size_t size = size_t(height) * width;
+
+    std::vector<float> input(channel * size);
+    std::mt19937 gen(height * 131 + width);
+    for (int k = 0; k < channel; ++k)
+        random_heatmap(input.data() + k * size, height, width, 5, gen);
+
+    using peak_list = std::vector<std::pair<int, int>>;
+    std::vector<peak_list> expected(channel), actual(channel);
+    const auto kernel = hyperpose::gaussian_kernel(17, 3);
+
+    const std::string shape = "[" + std::to_string(channel) + ", " + std::to_string(height) + ", " + std::to_string(width) + "]";
+
+    std::vector<float> smoothed(channel * size), pooled(channel * size), column_max(width);
+    hyperpose::gaussian_row_cache cache;
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k)
+                hyperpose::separable_gaussian_blur_2d(height, width, input.data() + k * size, smoothed.data() + k * size, kernel, cache);
+            for (int k = 0; k < channel; ++k)
+                hyperpose::same_max_pool_3x3_2d_simd(height, width, smoothed.data() + k * size, pooled.data() + k * size, column_max.data());
+            for (int k = 0; k < channel; ++k) {
+                expected[k].clear();
+                for (int y = 0; y < height; ++y)
+                    for (int x = 0; x < width; ++x) {
+                        const size_t off = k * size + y * width + x;
+                        if (smoothed[off] > threshold && smoothed[off] == pooled[off])
+                            expected[k].emplace_back(y, x);
+                    }
+            }
+        },
+        "Smooth + Pool + Threshold\t" + shape, loop_tms);
+
+    hyperpose::fused_peak_extractor extractor;
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k) {
+                actual[k].clear();
+                extractor.extract(height, width, input.data() + k * size, kernel, threshold,
+                    [&](int y, int x) { actual[k].emplace_back(y, x); });
+            }
+        },
+        std::string("Fused(") + hyperpose::simd::isa + ") Peak Extraction\t" + shape, loop_tms);
+
+    if (expected != actual) {
+        std::cerr << "[TEST FAILED] Fused peak extraction mismatches the unfused passes @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Sparse peak finding: searching the candidate tiles of the resized map must find exactly the dense peaks.
+static bool test_sparse_once(int src_height, int src_width, int height, int width, int n_blobs)
+{
+    constexpr float threshold = 0.1;
+    cv::Mat src(src_height, src_width, CV_32F);
+    std::mt19937 gen(src_height * 131 + src_width + n_blobs);
+    random_heatmap(src.ptr<float>(), src_height, src_width, n_blobs, gen, 2);
+    cv::Mat resized;
+    cv::resize(src, resized, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+
+    const std::string shape = "[" + std::to_string(src_height) + ", " + std::to_string(src_width) + "] -> ["
+        + std::to_string(height) + ", " + std::to_string(width) + "]";
+
+    const auto kernel = hyperpose::gaussian_kernel(17, 3);
+    hyperpose::fused_peak_extractor extractor;
+    std::vector<std::pair<int, int>> expected, actual;
+
+    bench(
+        [&] {
+            expected.clear();
+            extractor.extract(height, width, resized.ptr<float>(), kernel, threshold, [&](int y, int x) { expected.emplace_back(y, x); });
+        },
+        "Dense Peak Extraction\t" + shape);
+
+    hyperpose::candidate_tiles tiles;
+    bench(
+        [&] {
+            actual.clear();
+            tiles.find(src.ptr<float>(), src_height, src_width, height, width, kernel.size() / 2, threshold);
+            for (const auto& window : tiles.windows())
+                extractor.extract(height, width, resized.ptr<float>(), kernel, threshold, window, [&](int y, int x) { actual.emplace_back(y, x); });
+        },
+        "Sparse Peak Extraction\t" + shape);
+
+    if (expected != actual) {
+        std::cerr << "[TEST FAILED] Sparse peak extraction mismatches the dense one @ " << shape << std::endl;
+        return false;
+    }
+    if (n_blobs == 0 && !tiles.windows().empty()) {
+        std::cerr << "[TEST FAILED] Empty heatmap has candidate tiles @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// The recursive Gaussian smooths the bounding box of `windows` plus `margin` only, and the peaks are searched in
+// `windows`. (As the sparse peak finder does)
+static std::vector<std::pair<int, int>> recursive_window_peaks(int height, int width, const float* image,
+    const hyperpose::recursive_gaussian_coefficients& coefficients, int margin,
+    const std::vector<hyperpose::pixel_window>& windows, float threshold)
+{
+    const auto region = hyperpose::bounding_window(windows, margin, height, width);
+    const int rows = region.row_end - region.row_begin, cols = region.col_end - region.col_begin;
+    std::vector<float> smoothed(static_cast<size_t>(std::max(rows, 0)) * std::max(cols, 0)), line;
+    if (!windows.empty())
+        hyperpose::recursive_gaussian_blur_2d(rows, cols, image + region.row_begin * width + region.col_begin, width,
+            smoothed.data(), coefficients, line);
+
+    hyperpose::fused_peak_extractor extractor;
+    std::vector<std::pair<int, int>> peaks;
+    for (const auto& window : windows)
+        extractor.extract_smoothed(height, width, smoothed.data(), region, threshold, window, [&](int y, int x) { peaks.emplace_back(y, x); });
+    return peaks;
+}
+
+// Sparse peak finding with the recursive Gaussian: smoothing the candidate tiles (plus a margin) only must find the
+// peaks of the whole smoothed map.
+static bool test_recursive_sparse_once(int height, int width, int n_blobs)
+{
+    constexpr float threshold = 0.1, sigma = 3;
+    constexpr int radius = 12; // 4 sigma, as `peak_finder_t::smoothing_radius`.
+    std::vector<float> image(height * width);
+    std::mt19937 gen(height * 131 + width + n_blobs);
+    random_heatmap(image.data(), height, width, n_blobs, gen);
+
+    const std::string shape = "[" + std::to_string(height) + ", " + std::to_string(width) + "], " + std::to_string(n_blobs) + " blobs";
+
+    const auto coefficients = hyperpose::young_van_vliet(sigma);
+    hyperpose::fused_peak_extractor extractor;
+    std::vector<float> smoothed(height * width), line;
+    std::vector<std::pair<int, int>> expected, actual;
+
+    bench(
+        [&] {
+            expected.clear();
+            hyperpose::recursive_gaussian_blur_2d(height, width, image.data(), smoothed.data(), coefficients, line);
+            extractor.extract_smoothed(height, width, smoothed.data(), threshold, [&](int y, int x) { expected.emplace_back(y, x); });
+        },
+        "Dense Recursive Peak Extraction\t" + shape);
+
+    hyperpose::candidate_tiles tiles;
+    bench(
+        [&] {
+            tiles.find(image.data(), height, width, height, width, radius, threshold);
+            actual = recursive_window_peaks(height, width, image.data(), coefficients, 2 * radius + 1, tiles.windows(), threshold);
+        },
+        "Sparse Recursive Peak Extraction\t" + shape);
+
+    if (expected != actual) {
+        std::cerr << "[TEST FAILED] Sparse recursive peak extraction mismatches the dense one @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Video mode with the recursive Gaussian: searching the tiles around the previous key points must find exactly the
+// peaks of the whole smoothed map within these tiles, and none outside.
+static bool test_recursive_around_once(int height, int width, int n_blobs, const std::vector<hyperpose::pixel_window>& regions)
+{
+    constexpr float threshold = 0.1, sigma = 3;
+    constexpr int radius = 12; // 4 sigma, as `peak_finder_t::smoothing_radius`.
+    std::vector<float> image(height * width);
+    std::mt19937 gen(height * 131 + width + n_blobs);
+    random_heatmap(image.data(), height, width, n_blobs, gen);
+
+    const std::string shape = "[" + std::to_string(height) + ", " + std::to_string(width) + "], " + std::to_string(n_blobs)
+        + " blobs, " + std::to_string(regions.size()) + " regions";
+
+    const auto coefficients = hyperpose::young_van_vliet(sigma);
+    hyperpose::candidate_tiles tiles;
+    tiles.around(regions, height, width);
+    const auto inside = [&](const std::pair<int, int>& p) {
+        return std::any_of(tiles.windows().begin(), tiles.windows().end(), [&](const hyperpose::pixel_window& w) {
+            return w.row_begin <= p.first && p.first < w.row_end && w.col_begin <= p.second && p.second < w.col_end;
+        });
+    };
+
+    hyperpose::fused_peak_extractor extractor;
+    std::vector<float> smoothed(height * width), line;
+    std::vector<std::pair<int, int>> expected, actual;
+
+    bench(
+        [&] {
+            expected.clear();
+            hyperpose::recursive_gaussian_blur_2d(height, width, image.data(), smoothed.data(), coefficients, line);
+            extractor.extract_smoothed(height, width, smoothed.data(), threshold, [&](int y, int x) {
+                if (inside({ y, x }))
+                    expected.emplace_back(y, x);
+            });
+        },
+        "Dense Recursive Peak Extraction\t" + shape);
+
+    bench([&] { actual = recursive_window_peaks(height, width, image.data(), coefficients, 2 * radius + 1, tiles.windows(), threshold); },
+        "Windowed Recursive Peak Extraction\t" + shape);
+
+    if (expected != actual) {
+        std::cerr << "[TEST FAILED] Recursive peak extraction around the regions mismatches the dense one @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Sub-pixel refinement must locate a blob more precisely than the integer peak.
+static bool test_subpixel_once(float cy, float cx)
+{
+    constexpr int height = 24, width = 32;
+    std::vector<float> image(height * width);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            image[y * width + x] = std::exp(-((x - cx) * (x - cx) + (y - cy) * (y - cy)) / 2.f);
+
+    hyperpose::fused_peak_extractor extractor;
+    std::vector<std::pair<float, float>> peaks;
+    extractor.extract(height, width, image.data(), hyperpose::gaussian_kernel(5, 0.75), 0.1,
+        [&](int y, int x, float dy, float dx) { peaks.emplace_back(y + dy, x + dx); });
+
+    if (peaks.size() != 1 || std::abs(peaks[0].first - cy) > 0.1 || std::abs(peaks[0].second - cx) > 0.1) {
+        std::cerr << "[TEST FAILED] Sub-pixel refinement is inaccurate @ (" << cy << ", " << cx << ")" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_once(1, 1, 1, 1);
+    ok &= test_once(1, 1, 17, 1);
+    ok &= test_once(1, 17, 1, 1);
+    ok &= test_once(2, 3, 9, 1);
+
+    // Typical 4x upsampled OpenPose feature maps.
+    ok &= test_once(18, 128, 192, 10);
+    ok &= test_once(18, 184, 368, 10);
+
+    ok &= test_sparse_once(46, 92, 184, 368, 0);
+    ok &= test_sparse_once(46, 92, 184, 368, 3);
+    ok &= test_sparse_once(46, 92, 184, 368, 30);
+    ok &= test_sparse_once(32, 48, 128, 192, 2);
+    ok &= test_sparse_once(30, 50, 100, 130, 4); // Non-integer scales.
+    ok &= test_sparse_once(40, 40, 40, 40, 3); // No resizing.
+
+    ok &= test_recursive_sparse_once(184, 368, 0);
+    ok &= test_recursive_sparse_once(184, 368, 3);
+    ok &= test_recursive_sparse_once(184, 368, 30);
+    ok &= test_recursive_sparse_once(368, 432, 5);
+
+    ok &= test_recursive_around_once(184, 368, 10, {});
+    ok &= test_recursive_around_once(184, 368, 30, { { 40, 100, 100, 200 } });
+    ok &= test_recursive_around_once(368, 432, 30, { { 0, 50, 0, 50 }, { 300, 368, 380, 432 }, { 100, 200, 150, 300 } });
+
+    ok &= test_subpixel_once(12, 16);
+    ok &= test_subpixel_once(11.3, 16.45);
+    ok &= test_subpixel_once(12.7, 15.6);
+
+    return ok ? 0 : 1;
+}
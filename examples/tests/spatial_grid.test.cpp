@@ -0,0 +1,73 @@
+#include "spatial_grid.hpp"
+#include "test_utility.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Grid queries must return exactly the points a brute-force search finds, in the same order.
+// `n` plays the role of the people count: every point of one part is queried against the points of another part.
+static bool test_once(int n, float width, float height, float radius, float cell_size, int loop_tms)
+{
+    std::mt19937 gen(n);
+    std::uniform_real_distribution<float> dist_x(0, width), dist_y(0, height);
+    std::vector<float> xs(n), ys(n), qxs(n), qys(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = dist_x(gen);
+        ys[i] = dist_y(gen);
+        qxs[i] = dist_x(gen);
+        qys[i] = dist_y(gen);
+    }
+
+    const std::string shape = "n = " + std::to_string(n) + ", r = " + std::to_string(radius);
+
+    std::vector<std::vector<size_t>> expected(n), actual(n);
+    bench(
+        [&] {
+            for (int q = 0; q < n; ++q) {
+                expected[q].clear();
+                for (int i = 0; i < n; ++i) {
+                    const float dx = xs[i] - qxs[q], dy = ys[i] - qys[q];
+                    if (dx * dx + dy * dy <= radius * radius)
+                        expected[q].push_back(i);
+                }
+            }
+        },
+        "Brute-force Radius Search\t" + shape, loop_tms);
+
+    hyperpose::spatial_grid grid;
+    bench(
+        [&] {
+            grid.build(xs.data(), ys.data(), n, cell_size);
+            for (int q = 0; q < n; ++q) {
+                actual[q].clear();
+                grid.query(qxs[q], qys[q], radius, actual[q]);
+            }
+        },
+        "Spatial Grid Radius Search\t" + shape, loop_tms);
+
+    if (expected != actual) {
+        std::cerr << "[TEST FAILED] Spatial grid mismatches the brute-force search @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_once(0, 100, 100, 10, 10, 1);
+    ok &= test_once(1, 100, 100, 10, 10, 1);
+    ok &= test_once(50, 100, 100, 200, 200, 1); // One cell.
+    ok &= test_once(50, 100, 100, 10, 1e-3, 1); // Cells much smaller than the radius.
+
+    // Peaks of crowded 4x upsampled feature maps.
+    for (int n : { 10, 50, 200, 1000 })
+        ok &= test_once(n, 736, 736, 74, 74, 10);
+
+    return ok ? 0 : 1;
+}
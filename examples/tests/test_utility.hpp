@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+template <typename Func, typename S>
+static void bench(Func&& func, const S& log, int loop_tms = 1)
+{
+    auto beg = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop_tms; ++i)
+        func();
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "[Bench] \t@ " << log << ": \tFor \t<<< " << loop_tms
+              << " >>> times, cost \t<<<"
+              << std::chrono::duration<double, std::milli>(end - beg).count()
+              << ">>> ms" << std::endl;
+}
+
+// Heatmap-like input: `n_blobs` Gaussian blobs (of peak 1 and variance `spread` / 2) over low-level noise.
+inline void random_heatmap(float* image, int height, int width, int n_blobs, std::mt19937& gen, float spread = 50)
+{
+    std::uniform_real_distribution<float> dist(0, 1);
+    for (int i = 0; i < height * width; ++i)
+        image[i] = 0.05f * dist(gen);
+    for (int n = 0; n < n_blobs; ++n) {
+        const float cx = dist(gen) * width, cy = dist(gen) * height;
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                image[y * width + x] += std::exp(-((x - cx) * (x - cx) + (y - cy) * (y - cy)) / spread);
+    }
+}
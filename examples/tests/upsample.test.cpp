@@ -0,0 +1,92 @@
+#include "upsample.hpp"
+#include "test_utility.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// The replicating upsampler must be bit-identical to cv::resize(INTER_AREA) for integer factors.
+static bool test_once(int channel, int height, int width, int factor_y, int factor_x, int loop_tms)
+{
+    const int target_height = height * factor_y, target_width = width * factor_x;
+    const size_t size = size_t(height) * width, target_size = size_t(target_height) * target_width;
+
+    std::vector<float> input(channel * size), expected(channel * target_size), actual(channel * target_size);
+    std::mt19937 gen(height * 131 + width);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    for (auto& v : input)
+        v = dist(gen);
+
+    const std::string shape = "[" + std::to_string(channel) + ", " + std::to_string(height) + ", " + std::to_string(width)
+        + "] x [" + std::to_string(factor_y) + ", " + std::to_string(factor_x) + "]";
+
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k) {
+                const cv::Mat src(cv::Size(width, height), CV_32F, input.data() + k * size);
+                cv::Mat dst(cv::Size(target_width, target_height), CV_32F, expected.data() + k * target_size);
+                cv::resize(src, dst, dst.size(), 0, 0, cv::INTER_AREA);
+            }
+        },
+        "cv::resize(INTER_AREA)\t" + shape, loop_tms);
+
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k)
+                hyperpose::replicate_upsample_2d(height, width, input.data() + k * size, actual.data() + k * target_size, factor_y, factor_x);
+        },
+        std::string("Replicate(") + hyperpose::simd::isa + ") Upsample\t" + shape, loop_tms);
+
+    if (std::memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)) != 0) {
+        std::cerr << "[TEST FAILED] Upsampling mismatches cv::resize(INTER_AREA) @ " << shape << std::endl;
+        return false;
+    }
+
+    // FP16 input is widened on the fly, which must be the same as widening it first.
+    const int n = static_cast<int>(input.size());
+    std::vector<std::uint16_t> input_half(n);
+    std::vector<float> widened(n);
+    cv::Mat input_mat(1, n, CV_32F, input.data()), half_mat(1, n, CV_16F, input_half.data()), widened_mat(1, n, CV_32F, widened.data());
+    input_mat.convertTo(half_mat, CV_16F);
+    half_mat.convertTo(widened_mat, CV_32F);
+
+    for (int k = 0; k < channel; ++k)
+        hyperpose::replicate_upsample_2d(height, width, widened.data() + k * size, expected.data() + k * target_size, factor_y, factor_x);
+
+    bench(
+        [&] {
+            for (int k = 0; k < channel; ++k)
+                hyperpose::replicate_upsample_2d(height, width, input_half.data() + k * size, actual.data() + k * target_size, factor_y, factor_x);
+        },
+        std::string("Replicate(") + hyperpose::simd::isa + ") FP16 Upsample\t" + shape, loop_tms);
+
+    if (std::memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)) != 0) {
+        std::cerr << "[TEST FAILED] FP16 upsampling mismatches widening first @ " << shape << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+
+    // Corner cases.
+    ok &= test_once(1, 1, 1, 4, 4, 1);
+    ok &= test_once(1, 3, 17, 2, 2, 1);
+    ok &= test_once(1, 5, 9, 3, 3, 1);
+    ok &= test_once(2, 7, 11, 2, 4, 1);
+
+    // Typical OpenPose feature maps (CONF and PAF).
+    ok &= test_once(19, 46, 46, 4, 4, 10);
+    ok &= test_once(38, 32, 48, 4, 4, 10);
+    ok &= test_once(38, 46, 92, 2, 2, 10);
+
+    return ok ? 0 : 1;
+}
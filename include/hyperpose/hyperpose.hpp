@@ -6,6 +6,7 @@
 #include "utility/data.hpp"
 #include "utility/human.hpp"
 #include "utility/logging.hpp"
+#include "utility/topology.hpp"
 
 #include "operator/dnn/tensorrt.hpp"
 #include "operator/parser/paf.hpp"
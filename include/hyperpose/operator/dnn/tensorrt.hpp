@@ -10,21 +10,6 @@
 
 namespace hyperpose {
 
-/// Data type related to TensorRT data type.
-struct data_type {
-    static constexpr int kFLOAT = 0; //!< FP32 format.
-    static constexpr int kHALF = 1; //!< FP16 format.
-    static constexpr int kINT8 = 2; //!< quantized INT8 format.
-    static constexpr int kINT32 = 3; //!< INT32 format.
-    static constexpr int kBOOL = 4; //!< BOOL format.
-
-    int val = kFLOAT;
-    inline data_type(int v)
-        : val(v)
-    {
-    }
-};
-
 /// \brief The namespace to contain things related to DNN. (e.g., DNN engines and model configurations.)
 /// \note In HyperPose, the pose estimation pipeline consists of DNN inference and parsing(post-processing). The DNN
 /// part implementation is under the namespace `hyperpose::dnn`.
@@ -41,12 +26,14 @@ namespace dnn {
         /// \param dtype The data type of data element. (for some GPUs, low precision data type will be faster)
         /// \param factor For each element in the input data, they will be multiplied by "factor".
         /// \param flip_rgb Whether to convert the color channels from "BGR" to "RGB".
+        /// \param half_outputs Whether to build the engine in FP16 mode with FP16 output feature maps. (half the memory
+        /// of the outputs on the host; see `hyperpose::feature_map_t::dtype`)
         explicit tensorrt(const uff& uff_model,
             cv::Size input_size,
             int max_batch_size = 8,
             bool keep_ratio = false,
             data_type dtype = data_type::kFLOAT,
-            double factor = 1. / 255, bool flip_rgb = true);
+            double factor = 1. / 255, bool flip_rgb = true, bool half_outputs = false);
 
         /// \brief The constructor of TensorRT engine using ONNX model file.
         ///
@@ -57,9 +44,11 @@ namespace dnn {
         /// \param dtype The data type of data element. (for some GPUs, low precision data type will be faster)
         /// \param factor For each element in the input data, they will be multiplied by "factor".
         /// \param flip_rgb Whether to convert the color channels from "BGR" to "RGB".
+        /// \param half_outputs Whether to build the engine in FP16 mode with FP16 output feature maps. (half the memory
+        /// of the outputs on the host; see `hyperpose::feature_map_t::dtype`)
         explicit tensorrt(const onnx& onnx_model, cv::Size input_size, int max_batch_size = 8, bool keep_ratio = false,
             data_type dtype = data_type::kFLOAT,
-            double factor = 1. / 255, bool flip_rgb = true);
+            double factor = 1. / 255, bool flip_rgb = true, bool half_outputs = false);
 
         /// \brief The constructor of TensorRT engine using TensorRT serialized model file.
         ///
@@ -4,6 +4,9 @@
 /// \brief Post-processing using Part Affinity Field (PAF).
 
 #include "../../utility/data.hpp"
+#include "../../utility/topology.hpp"
+
+#include <utility>
 
 namespace hyperpose {
 
@@ -12,10 +15,26 @@ namespace hyperpose {
 /// parser part implementation is under the namespace `hyperpose::parser`.
 namespace parser {
 
+    /// \brief Filters to smooth the confidence maps before finding peaks.
+    enum class smoothing_method {
+        gaussian, ///< Separable Gaussian convolution (ksize = 17, sigma = 3). The same as `cv::GaussianBlur`.
+        recursive_gaussian, ///< Recursive(IIR) Gaussian approximation (Young & van Vliet), whose cost doesn't depend on the kernel size.
+    };
+
     /// \brief Post-processing using Part Affinity Field (PAF).
+    /// \tparam Topology The skeleton topology of the model. (e.g., `hyperpose::coco_topology`)
+    /// \note The CONF tensor has `Topology::n_parts` key point channels (plus the background), and the PAF tensor
+    /// holds the channels of `Topology::limbs`. Use `hyperpose::parser::paf` for COCO models.
     /// \see https://arxiv.org/abs/1812.08008
-    class paf {
+    template <typename Topology>
+    class basic_paf {
     public:
+        /// The skeleton topology.
+        using topology_type = Topology;
+
+        /// The human type with `Topology::n_parts` key points.
+        using human_type = human_t_<Topology::n_parts>;
+
         /// \brief Constructor indicating the image size and thresholds.
         ///
         /// \param conf_thresh The activation threshold.
@@ -24,7 +43,7 @@ namespace parser {
         /// \note Before doing PAF, the (width, height) of feature map will be expanded to `resolution_size` to perform
         /// a more accurate post processing. And `resolution_size` will be N x the size of first input tensor if it's
         /// not set. (now, N is 4)
-        explicit paf(float conf_thresh = 0.05, float paf_thresh = 0.05, cv::Size resolution_size = cv::Size(UNINITIALIZED_VAL, UNINITIALIZED_VAL));
+        explicit basic_paf(float conf_thresh = 0.05, float paf_thresh = 0.05, cv::Size resolution_size = cv::Size(UNINITIALIZED_VAL, UNINITIALIZED_VAL));
 
         /// \brief Function to process one image.
         ///
@@ -45,7 +64,9 @@ namespace parser {
         /// \param conf The conf tensor.
         /// \param paf The paf tensor.
         /// \return All human topologies found in "this" image.
-        std::vector<human_t> process(const feature_map_t& conf, const feature_map_t& paf);
+        /// \note The tensors can be FP32 or FP16(`hyperpose::data_type::kHALF`), FP16 values are converted while being
+        /// upsampled.
+        std::vector<human_type> process(const feature_map_t& conf, const feature_map_t& paf);
 
         /// \brief Function to process one image.
         ///
@@ -55,12 +76,82 @@ namespace parser {
         /// \return All human topologies found in "this" image.
         /// \note Template parameter `C` must support `operator[]` as indexing.
         template <typename C>
-        std::vector<human_t> process(C&& feature_map_containers)
+        std::vector<human_type> process(C&& feature_map_containers)
         {
             // 1@conf, 2@paf.
             return process(feature_map_containers[0], feature_map_containers[1]);
         }
 
+        /// \brief Function to process a batch of images in parallel.
+        ///
+        /// \code
+        /// auto tensor_pairs = engine.inference(...);
+        /// auto pose_sets = paf_processor.process_batch(tensor_pairs);
+        /// \endcode
+        ///
+        /// \param batch {CONF, PAF} tensors of each image, e.g., the output of `hyperpose::dnn::tensorrt::inference`.
+        /// \return All human topologies found in each image, in the order of `batch`.
+        /// \note The images are parsed in one `hyperpose::parallel_for`, and each thread running it keeps its own buffers.
+        /// So the memory used grows with the number of threads rather than the batch size, and one parser is enough for a
+        /// whole batch. In the video mode(`set_video_mode`), the images are consecutive frames and parsed one by one on
+        /// the calling thread instead. An empty batch returns no pose set.
+        std::vector<std::vector<human_type>> process_batch(std::vector<internal_t>& batch);
+
+        /// \brief Function to process a batch of images in parallel, telling how each of them was degraded.
+        ///
+        /// \param batch See the other `process_batch`.
+        /// \param degradations Set to the `hyperpose::degradation` flags applied to each image to meet the time budget,
+        /// in the order of `batch`. (e.g., an image without human because of `degradation::kPARTIAL` is told apart from
+        /// an image without any)
+        /// \return See the other `process_batch`.
+        std::vector<std::vector<human_type>> process_batch(std::vector<internal_t>& batch, std::vector<int>& degradations);
+
+        /// \brief Function to process one image with several thresholds, e.g., to tune them.
+        ///
+        /// \code
+        /// auto pose_sets = paf_processor.process_thresholds(conf, paf, { { 0.05, 0.05 }, { 0.1, 0.05 }, { 0.1, 0.1 } });
+        /// \endcode
+        ///
+        /// \param conf The conf tensor.
+        /// \param paf The paf tensor.
+        /// \param thresholds The (CONF threshold, PAF threshold) pairs to parse with.
+        /// \return All human topologies found with each pair, in the order of `thresholds`. The same as calling
+        /// `set_conf_thresh`, `set_paf_thresh` and `process` for each pair.
+        /// \note The maps are upsampled and smoothed once, the peaks are found once at the lowest CONF threshold, and the
+        /// limbs are scored once at the lowest PAF threshold. Each pair then only filters them and assembles its humans
+        /// (in parallel), so that a sweep of N pairs costs much less than N calls of `process`. It ignores the video mode
+        /// and the time budget, and doesn't change the thresholds of the parser.
+        std::vector<std::vector<human_type>> process_thresholds(const feature_map_t& conf, const feature_map_t& paf,
+            const std::vector<std::pair<float, float>>& thresholds);
+
+        /// \brief Allocate the buffers to parse feature maps of the given shapes ahead of time.
+        ///
+        /// \param conf_shape The shape of the CONF tensor. (No batch dimension)
+        /// \param paf_shape The shape of the PAF tensor. (No batch dimension)
+        /// \param dtype The data type of the tensors.
+        /// \param batch_size The number of images parsed at a time, i.e., the batch size of `process_batch`.
+        /// \note Otherwise the upsampled maps and the peak finder are allocated by the first `process`(or by each thread
+        /// of `process_batch`), which makes the first frames of a stream much slower. For a batch, the buffers of the
+        /// threads that a `hyperpose::parallel_for` of `batch_size` runs on are allocated. The parsing modes(e.g.,
+        /// `set_native_resolution_peak_finding`) must be set before, and the shapes must stay the same afterwards.
+        void prepare(const std::vector<int>& conf_shape, const std::vector<int>& paf_shape,
+            data_type dtype = data_type::kFLOAT, size_t batch_size = 1);
+
+        /// \brief `prepare`, then parse a dummy image with each buffer.
+        ///
+        /// \code
+        /// // Before the first frame.
+        /// paf_processor.warm_up({ 19, 46, 54 }, { 38, 46, 54 });
+        /// \endcode
+        ///
+        /// \see `prepare` for the parameters.
+        /// \return The time it took in milliseconds.
+        /// \note This also touches the buffers(and starts the threads of the parallel backend), so the first frame doesn't
+        /// wait for them.
+        /// The video mode state, the time budget and `last_degradations` are left untouched.
+        double warm_up(const std::vector<int>& conf_shape, const std::vector<int>& paf_shape,
+            data_type dtype = data_type::kFLOAT, size_t batch_size = 1);
+
         ///
         /// \param thresh The PAF threshold.
         void set_paf_thresh(float thresh);
@@ -69,12 +160,83 @@ namespace parser {
         /// \param thresh The CONF threshold.
         void set_conf_thresh(float thresh);
 
+        /// \brief Set the filter used to smooth the confidence maps.
+        /// \param method The smoothing method. (default: `smoothing_method::gaussian`)
+        /// \note The recursive filter is faster for large resolutions, but only approximates the Gaussian kernel.
+        void set_smoothing_method(smoothing_method method);
+
+        /// \brief Enable/disable sparse peak finding.
+        /// \param sparse Whether to skip the regions of the CONF map that cannot hold a peak. (default: false)
+        /// \note The CONF map is pre-scanned at its original resolution: only tiles with values above the CONF threshold
+        /// nearby are smoothed and searched, and an image with no such tile returns no human immediately. The result
+        /// is the same as the dense search. (The recursive filter smooths the bounding box of the tiles with a margin,
+        /// which may only break the ties of nearly flat peaks differently)
+        void set_sparse_peak_finding(bool sparse);
+
+        /// \brief Find peaks on the CONF map at its original resolution.
+        /// \param native Whether to skip upsampling the CONF map. (default: false)
+        /// \note Peaks are found on the original CONF map (about 16x less work than on the 4x upsampled one) and refined
+        /// to sub-pixel accuracy with a quadratic fit. The refined key points are reported in the same coordinates as the
+        /// upsampled search, but may differ from it by a fraction of a pixel.
+        void set_native_resolution_peak_finding(bool native);
+
+        /// \brief Sample the PAF map at its original resolution.
+        /// \param native Whether to skip upsampling the PAF map. (default: false)
+        /// \note Instead of upsampling all PAF channels, the PAF vectors along each candidate limb are read from the
+        /// original PAF map with bilinear interpolation.
+        void set_native_resolution_paf_sampling(bool native);
+
+        /// \brief Limit the length of limbs to score.
+        /// \param ratio The max limb length over the height of the image. (default: 0, unlimited)
+        /// \note Only the pairs of peaks closer than this are scored, which are looked up with a spatial grid instead of
+        /// trying all pairs. This keeps the parsing time of crowded images (nearly) linear in the number of people, but
+        /// misses the limbs longer than `ratio` of the image height, e.g., of people close to the camera.
+        void set_max_limb_length(float ratio);
+
+        /// \brief Cap the number of peaks per body part.
+        /// \param k Only the `k` highest scoring peaks of each CONF channel are connected. (default: 0, unlimited)
+        /// \note This bounds the worst-case parsing time of each image, and the number of humans found to `k`.
+        void set_max_peaks_per_part(int k);
+
+        /// \brief Only find key points in some regions of the image, e.g., a doorway.
+        /// \param regions Rectangles relative to the image size, i.e., in [0, 1] like the key points of `human_type`.
+        /// (default: empty, the whole image)
+        /// \note Only the tiles of the CONF map overlapping the regions are smoothed(by the recursive filter: their
+        /// bounding box with a margin), pooled and searched, and only the key points inside are connected, so these
+        /// stages cost less in proportion to the masked area. The humans partly outside the regions lose the key points
+        /// out there. The maps are still upsampled as a whole, unless they are read at their original resolution.
+        /// (`set_native_resolution_peak_finding`, `set_native_resolution_paf_sampling`)
+        void set_regions_of_interest(std::vector<cv::Rect2f> regions);
+
+        /// \brief Parse the inputs as the consecutive frames of a video.
+        /// \param keyframe_interval Fully parse one of every `keyframe_interval` frames. (default: 0, video mode off)
+        /// \param max_motion How far a key point can move between 2 frames, over the height of the image.
+        /// \note Between key frames, peaks are only searched within `max_motion` around the key points of the previous
+        /// frame(whichever the smoothing method), and only the peaks near the same previous human are paired. A frame is fully parsed anyway if less than
+        /// half of the previous key points are found again(e.g., a scene change), but people entering the scene are only
+        /// found on the next key frame. Calling this function also resets the video.
+        void set_video_mode(int keyframe_interval, float max_motion = 0.05);
+
+        /// \brief Set a time budget to parse each image.
+        /// \param milliseconds The time budget of one image. (default: 0, unlimited)
+        /// \note The cost of connecting the key points grows with the number of people. When it's predicted to exceed
+        /// the time left, the parser degrades in stages until it fits: cap the key points of each part, sample the PAF
+        /// less, skip the virtual limbs and, at last, only connect the first limb types(i.e., return partial humans).
+        /// The prediction is measured on the previous images(of the same thread), so the first image is only degraded
+        /// once its deadline has passed. See `last_degradations` for what was applied.
+        void set_time_budget(double milliseconds);
+
+        /// \brief The degradations applied to meet the time budget.
+        /// \return `hyperpose::degradation` flags of the image parsed by the last `process`, or of the images of the last
+        /// `process_batch`. (OR-ed; see `process_batch(batch, degradations)` for the flags of each image)
+        int last_degradations() const;
+
         /// \note This copy constructor will only copy the parameters introduces in constructor(`hyperpose::paf`).
         /// \param p Object to be "copied".
-        paf(const paf& p);
+        basic_paf(const basic_paf& p);
 
         /// Deconstructor.
-        ~paf();
+        ~basic_paf();
 
     private:
         static constexpr std::nullptr_t UNINITIALIZED_PTR = nullptr;
@@ -82,6 +244,15 @@ namespace parser {
 
         float m_conf_thresh, m_paf_thresh;
         cv::Size m_resolution_size;
+        smoothing_method m_smoothing = smoothing_method::gaussian;
+        bool m_sparse_peak_finding = false;
+        bool m_native_resolution_peak_finding = false;
+        bool m_native_resolution_paf_sampling = false;
+        float m_max_limb_length = 0;
+        int m_max_peaks_per_part = 0;
+        std::vector<cv::Rect2f> m_regions_of_interest;
+        double m_time_budget = 0;
+        int m_last_degradations = degradation::kNONE;
         int m_n_joints = UNINITIALIZED_VAL, m_n_connections = UNINITIALIZED_VAL;
         cv::Size m_feature_size = { UNINITIALIZED_VAL, UNINITIALIZED_VAL };
 
@@ -89,9 +260,35 @@ namespace parser {
         std::unique_ptr<ttl_impl> m_ttl;
 
         struct peak_finder_impl;
-        std::unique_ptr<peak_finder_impl> m_peak_finder_ptr;
+
+        struct batch_impl;
+        std::unique_ptr<batch_impl> m_batch;
+
+        int m_keyframe_interval = 0;
+        float m_max_motion = 0;
+        struct video_impl;
+        std::unique_ptr<video_impl> m_video;
+
+        void check_feature_maps(const feature_map_t& conf, const feature_map_t& paf);
+        void prepare_buffers(const feature_map_t& conf, const feature_map_t& paf, size_t batch_size, bool parse);
+        std::vector<human_type> process(ttl_impl& buffers, const feature_map_t& conf, const feature_map_t& paf,
+            video_impl* video = nullptr);
     };
 
+    /// \brief PAF post-processing of COCO models. (`hyperpose::human_t`)
+    using paf = basic_paf<coco_topology>;
+
+    /// \brief PAF post-processing of OpenPose BODY_25 models.
+    using body25_paf = basic_paf<body25_topology>;
+
+    /// \brief PAF post-processing of 21 key point hand models.
+    using hand_paf = basic_paf<hand21_topology>;
+
+    // Only the built-in topologies are compiled into the library.
+    extern template class basic_paf<coco_topology>;
+    extern template class basic_paf<body25_topology>;
+    extern template class basic_paf<hand21_topology>;
+
 } // namespace parser
 
 } // namespace hyperpose
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "../../utility/data.hpp"
 #include <algorithm>
+#include <memory>
 #include <numeric>
 #include <utility>
 
@@ -36,7 +37,7 @@ namespace parser {
         /// \param edge
         ///
         /// \note To use this function, the output of your PoseProposal model should be 6 tensors: `[key point confidence, iou conf, center_x, center_y, box_width, box_height, edge confidence]`.
-        /// This is natively supported by our training framework.
+        /// This is natively supported by our training framework. The tensors can be FP32 or FP16(`hyperpose::data_type::kHALF`).
         ///
         /// \return A list of inferred human poses.
         std::vector<human_t> process(
@@ -61,6 +62,27 @@ namespace parser {
                 feature_map_list.at(6));
         }
 
+        /// \brief Function to process a batch of images in parallel.
+        ///
+        /// \code
+        /// auto feature_map_lists = engine.inference(...);
+        /// auto pose_sets = parser.process_batch(feature_map_lists);
+        /// \endcode
+        ///
+        /// \param batch The 7 tensors(see `process`) of each image, e.g., the output of `hyperpose::dnn::tensorrt::inference`.
+        /// \return All human poses found in each image, in the order of `batch`.
+        /// \note The images are parsed in one `hyperpose::parallel_for`, each with buffers of the thread running it, which
+        /// are kept for the next batches. So one parser is enough for a whole batch. (e.g., in `hyperpose::stream`)
+        std::vector<std::vector<human_t>> process_batch(std::vector<internal_t>& batch);
+
+        /// \brief Function to process a batch of images in parallel, telling how each of them was degraded.
+        ///
+        /// \param batch See the other `process_batch`.
+        /// \param degradations Set to the `hyperpose::degradation` flags applied to each image to meet the time budget,
+        /// in the order of `batch`.
+        /// \return See the other `process_batch`.
+        std::vector<std::vector<human_t>> process_batch(std::vector<internal_t>& batch, std::vector<int>& degradations);
+
         /// \brief Set the key point threshold.
         /// \param thresh key point threshold.
         void set_point_thresh(float thresh);
@@ -73,11 +95,51 @@ namespace parser {
         /// \param thresh NMS threshold.
         void set_nms_thresh(float thresh);
 
+        /// \brief Only find key points in some regions of the image, e.g., a doorway.
+        /// \param regions Rectangles relative to the image size, i.e., in [0, 1] like the key points of `human_t`.
+        /// (default: empty, the whole image)
+        /// \note The grid cells whose centers are outside the regions are skipped, so the key points of the humans partly
+        /// outside are lost there.
+        void set_regions_of_interest(std::vector<cv::Rect2f> regions);
+
+        /// \brief Set a time budget to parse each image.
+        /// \param milliseconds The time budget of one image. (default: 0, unlimited)
+        /// \note When connecting(and merging) the key points is predicted to exceed the time left, only the highest
+        /// scoring key points of each part are connected, and then the limb types that don't fit in the time left are
+        /// skipped(i.e., partial humans are returned). The prediction is measured on the previous images, so the first
+        /// image is only degraded once its deadline has passed. See `last_degradations`.
+        void set_time_budget(double milliseconds);
+
+        /// \brief The degradations applied to meet the time budget.
+        /// \return `hyperpose::degradation` flags of the image parsed by the last `process`, or of the images of the last
+        /// `process_batch`. (OR-ed; see `process_batch(batch, degradations)` for the flags of each image)
+        int last_degradations() const;
+
+        /// \note This copy constructor will only copy the parameters(including the setters) but not the working buffers.
+        /// \param p Object to be "copied".
+        pose_proposal(const pose_proposal& p);
+
+        /// Deconstructor.
+        ~pose_proposal();
+
     private:
         cv::Size m_net_resolution;
         float m_point_thresh;
         float m_limb_thresh;
         float m_nms_thresh;
+        std::vector<cv::Rect2f> m_regions_of_interest;
+        double m_time_budget = 0;
+        int m_last_degradations = degradation::kNONE;
+
+        struct workspace;
+        std::unique_ptr<workspace> m_workspace; // For `process`.
+        struct batch_workspaces;
+        std::unique_ptr<batch_workspaces> m_batch_workspaces; // For `process_batch`, per thread.
+
+        std::vector<human_t> process(workspace& ws,
+            const feature_map_t& conf_point, const feature_map_t& conf_iou,
+            const feature_map_t& x, const feature_map_t& y, const feature_map_t& w, const feature_map_t& h,
+            const feature_map_t& edge);
     };
 
 }
@@ -3,9 +3,14 @@
 /// \file stream.hpp
 /// \brief Stream processing for pose estimation.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "../utility/data.hpp"
@@ -31,6 +36,8 @@ public:
 
     size_t processed_num() const noexcept;
 
+    double first_frame_latency() const noexcept;
+
     void read_from(const std::vector<cv::Mat>&);
     void read_from(cv::VideoCapture&);
     void read_from(cv::Mat);
@@ -43,6 +50,9 @@ public:
     template <typename ParserList>
     void parse_from_internals(ParserList&& parser_list);
 
+    template <typename Parser>
+    void parse_batches_from_internals(Parser& parser);
+
     template <typename NameGenerator>
     enable_if_name_getter_t<NameGenerator> write_to(NameGenerator&& name_getter);
     void write_to(cv::VideoWriter&);
@@ -52,12 +62,18 @@ public:
     ~basic_stream_manager();
 
 private:
+    void report_first_frame();
+
     std::atomic<size_t> m_remaining_num{ 0 };
     std::atomic<size_t> m_ingest{ 0 };
     const bool m_use_original_resolution;
     const bool m_keep_ratio;
     cv::Size m_input_size;
 
+    // From the time the first input is taken for resizing to the time its output is written.
+    std::chrono::steady_clock::time_point m_first_input_time{};
+    std::atomic<double> m_first_frame_latency{ 0 };
+
     bool m_shutdown = false;
     std::mutex m_global_mutex;
     std::condition_variable m_shutdown_notifier;
@@ -88,6 +104,27 @@ private:
     thread_pool m_thread_pool;
 };
 
+/// Whether `Parser` can parse a whole batch at once. (`Parser::process_batch(std::vector<internal_t>&)`)
+template <typename Parser, typename = void>
+struct has_process_batch : std::false_type {
+};
+
+template <typename Parser>
+struct has_process_batch<Parser, std::void_t<decltype(std::declval<Parser&>().process_batch(std::declval<std::vector<internal_t>&>()))>>
+    : std::true_type {
+};
+
+/// Whether `Parser` can allocate its buffers and parse a dummy image ahead of time.
+/// (`Parser::warm_up(conf_shape, paf_shape, data_type, batch_size)`)
+template <typename Parser, typename = void>
+struct has_warm_up : std::false_type {
+};
+
+template <typename Parser>
+struct has_warm_up<Parser, std::void_t<decltype(std::declval<Parser&>().warm_up(std::declval<const std::vector<int>&>(), std::declval<const std::vector<int>&>(), std::declval<data_type>(), std::declval<size_t>()))>>
+    : std::true_type {
+};
+
 /// \brief The class to do end-to-end stream processing for pose estimation.
 /**
  * @code
@@ -108,6 +145,9 @@ private:
  * // Create a stream.
  * auto stream = hyperpose::make_stream(engine, paf_processor);
  *
+ * // Optional: Do the first-run work before the first frame.
+ * stream.warm_up();
+ *
  * // Set input stream asynchronously.
  * stream.async() << cap;
  *
@@ -127,6 +167,7 @@ public:
     /// \param use_original_resolution If true, the output image size will be the input image size, otherwise the DNN input size.
     /// \param keep_ratio Whether to keep original aspect ratio. This is good for accuracy, but requires extra steps to refine the `hyperpose::human_t`.
     /// \param parser_cnt The number of parsers to do parallel post processing. (default: the DNN engine's batch size)
+    /// This is ignored if `Parser` has `process_batch`, which parses each batch in parallel with the given parser itself.
     /// \param queue_max_size The maximum value of internal packet queue sizes.
     /// \note Using the DNN input size as the output resolution(`use_original_resolution = false`) is usually faster.
     /// Because it reduces 1x memory copy. However, the DNN input size are usually much smaller than what you expected.
@@ -136,7 +177,7 @@ public:
         : m_stream_manager(queue_max_size, use_original_resolution, keep_ratio, engine.input_size())
         , m_engine_ref(engine)
         , m_main_parser_ref(parser)
-        , m_parser_replicas(parser_cnt == 0 ? engine.max_batch_size() : parser_cnt, parser)
+        , m_parser_replicas(has_process_batch<Parser>::value ? 0 : parser_cnt == 0 ? engine.max_batch_size() : parser_cnt, parser)
     {
         m_parser_refs.reserve(m_parser_replicas.size() + 1);
         m_parser_refs.push_back(std::ref(parser));
@@ -234,6 +275,42 @@ public:
     /// \return The number of ingested frames.
     size_t processed_num() const noexcept { return m_stream_manager.processed_num(); }
 
+    /// \brief Run the DNN engine and the parsers on a dummy batch ahead of time.
+    /// \return The time it took in milliseconds.
+    /// \note The first run of the DNN engine and the lazy allocations of the parsers would otherwise delay the first
+    /// frames. Parsers having `warm_up`(e.g., `hyperpose::parser::paf`) allocate all their buffers for the output shapes
+    /// of the engine, the others parse the dummy batch once. Call it before setting the input streams.
+    double warm_up()
+    {
+        const auto begin = std::chrono::steady_clock::now();
+
+        std::vector<cv::Mat> dummy_inputs(m_engine_ref.max_batch_size(), cv::Mat::zeros(m_engine_ref.input_size(), CV_8UC3));
+        auto internals = m_engine_ref.inference(std::move(dummy_inputs));
+
+        if (internals.empty())
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        if constexpr (has_warm_up<Parser>::value) {
+            const auto& maps = internals.front();
+            if constexpr (has_process_batch<Parser>::value)
+                m_main_parser_ref.warm_up(maps[0].shape(), maps[1].shape(), maps[0].dtype(), internals.size());
+            else
+                for (auto&& parser : m_parser_refs)
+                    parser.get().warm_up(maps[0].shape(), maps[1].shape(), maps[0].dtype(), 1);
+        } else if constexpr (has_process_batch<Parser>::value) {
+            m_main_parser_ref.process_batch(internals);
+        } else { // Like the first batch, which is parsed round robin.
+            for (size_t i = 0; i < std::min(m_parser_refs.size(), internals.size()); ++i)
+                m_parser_refs[i].get().process(std::move(internals[i]));
+        }
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    /// \brief The latency of the first frame, from the time the stream picks it up to the time its output is written.
+    /// \return The latency in milliseconds, or 0 if no frame has been written yet.
+    double first_frame_latency() const noexcept { return m_stream_manager.first_frame_latency(); }
+
 private:
     auto& get_tracer()
     {
@@ -270,7 +347,10 @@ private:
         }));
 
         tracer.push_back(std::async([this] {
-            m_stream_manager.parse_from_internals(m_parser_refs);
+            if constexpr (has_process_batch<Parser>::value)
+                m_stream_manager.parse_batches_from_internals(m_main_parser_ref);
+            else
+                m_stream_manager.parse_from_internals(m_parser_refs);
         }));
     }
 
@@ -384,6 +464,27 @@ void basic_stream_manager::parse_from_internals(ParserList&& parser_list)
     }
 }
 
+template <typename Parser>
+void basic_stream_manager::parse_batches_from_internals(Parser& parser)
+{
+    while (true) {
+        {
+            std::unique_lock lk{ m_after_inference_queue.m_mu };
+            m_cv_dnn_inf.wait(lk,
+                [this] { return m_after_inference_queue.m_size > 0 || m_shutdown; });
+        }
+
+        if (m_pose_sets_queue.m_size == 0 && m_shutdown)
+            break;
+
+        auto internals = m_after_inference_queue.dump_all();
+        auto pose_sets = parser.process_batch(internals);
+
+        m_pose_sets_queue.wait_until_pushed(std::move(pose_sets));
+        m_cv_post_processing.notify_one();
+    }
+}
+
 template <typename NameGetter>
 basic_stream_manager::enable_if_name_getter_t<NameGetter>
 basic_stream_manager::write_to(NameGetter&& name_getter)
@@ -406,6 +507,7 @@ basic_stream_manager::write_to(NameGetter&& name_getter)
                 draw_human(raw_image, pose);
             }
             cv::imwrite(name_getter(), raw_image);
+            report_first_frame();
             --m_remaining_num;
         }
 
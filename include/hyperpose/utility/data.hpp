@@ -12,6 +12,31 @@
 
 namespace hyperpose {
 
+/// Data type related to TensorRT data type.
+struct data_type {
+    static constexpr int kFLOAT = 0; //!< FP32 format.
+    static constexpr int kHALF = 1; //!< FP16 format.
+    static constexpr int kINT8 = 2; //!< quantized INT8 format.
+    static constexpr int kINT32 = 3; //!< INT32 format.
+    static constexpr int kBOOL = 4; //!< BOOL format.
+
+    int val = kFLOAT;
+    inline data_type(int v)
+        : val(v)
+    {
+    }
+};
+
+/// \brief The shortcuts a parser took to parse an image within its time budget. (Bit flags)
+/// \see `hyperpose::parser::paf::set_time_budget`, `hyperpose::parser::pose_proposal::set_time_budget`.
+struct degradation {
+    static constexpr int kNONE = 0; //!< Fully parsed.
+    static constexpr int kPEAK_CAP = 1; //!< Only the highest scoring key points of each part were connected.
+    static constexpr int kFEWER_PAF_SAMPLES = 2; //!< Limbs were scored with fewer PAF samples.
+    static constexpr int kSKIPPED_VIRTUAL_LIMBS = 4; //!< Virtual limbs(e.g., ear to shoulder) were not connected.
+    static constexpr int kPARTIAL = 8; //!< Some limb types were not connected, so the humans may miss key points.
+};
+
 /// \brief The feature map tensor class.
 /// \note This class extends `ttl::tensor` with names and output stream operator.
 struct feature_map_t {
@@ -20,7 +45,9 @@ public:
     /// \param name Tensor name. (Often from DNN engine graphs)
     /// \param tensor Tensor data.
     /// \param shape Shape of tensor. (no batch dimension)
-    feature_map_t(std::string name, std::unique_ptr<char[]>&& tensor, std::vector<int> shape);
+    /// \param dtype Data type of tensor elements. (The parsers accept `data_type::kFLOAT` and `data_type::kHALF`)
+    feature_map_t(std::string name, std::unique_ptr<char[]>&& tensor, std::vector<int> shape,
+        data_type dtype = data_type::kFLOAT);
 
     /// \brief Output operator.
     /// \param out Output stream.
@@ -36,6 +63,11 @@ public:
     /// \return Shape of feature map. (No batch dimension).
     inline const std::vector<int>& shape() const { return m_shape; }
 
+    ///
+    /// \return Data type of feature map elements.
+    /// \note FP16 elements are viewed as `std::uint16_t`, i.e., the IEEE binary16 bits.
+    inline data_type dtype() const { return m_dtype; }
+
     ///
     /// \tparam T View type.
     /// \return Viewed data pointer.
@@ -49,6 +81,7 @@ private:
     std::string m_name;
     std::unique_ptr<char[]> m_data;
     std::vector<int> m_shape;
+    data_type m_dtype;
 };
 
 /// \brief A vector of feature maps.
@@ -0,0 +1,111 @@
+#pragma once
+
+/// \file topology.hpp
+/// \brief Skeleton topologies(key points and limbs) for bottom-up parsing.
+
+#include <array>
+
+#include "human.hpp"
+
+namespace hyperpose {
+
+/// \brief Class to describe a limb, i.e., a connection between 2 key points.
+struct limb_t {
+    int part1; ///< The key point index where the limb starts.
+    int part2; ///< The key point index where the limb ends.
+    int paf_x; ///< The channel of the x component in the PAF tensor.
+    int paf_y; ///< The channel of the y component in the PAF tensor.
+    bool is_virtual = false; ///< Virtual limbs only attach key points to found humans, but never start a new one.
+};
+
+// A topology is a class with `n_parts` (the number of key points) and `limbs` (a constexpr array of `limb_t`).
+// Limbs are assembled in array order, so each limb (but the first) should start from a key point which is already
+// reached by a previous limb.
+
+/// \brief COCO topology: 18 key points and 19 limbs. (The same as `hyperpose::human_t`)
+struct coco_topology {
+    static constexpr int n_parts = COCO_N_PARTS;
+    static constexpr std::array<limb_t, COCO_N_PAIRS> limbs = { {
+        { 1, 2, 12, 13 },
+        { 1, 5, 20, 21 },
+        { 2, 3, 14, 15 },
+        { 3, 4, 16, 17 },
+        { 5, 6, 22, 23 },
+        { 6, 7, 24, 25 },
+        { 1, 8, 0, 1 },
+        { 8, 9, 2, 3 },
+        { 9, 10, 4, 5 },
+        { 1, 11, 6, 7 },
+        { 11, 12, 8, 9 },
+        { 12, 13, 10, 11 },
+        { 1, 0, 28, 29 },
+        { 0, 14, 30, 31 },
+        { 14, 16, 34, 35 },
+        { 0, 15, 32, 33 },
+        { 15, 17, 36, 37 },
+        { 2, 16, 18, 19, true },
+        { 5, 17, 26, 27, true },
+    } };
+};
+
+/// \brief OpenPose BODY_25 topology: 25 key points (COCO + mid hip and feet) and 26 limbs.
+struct body25_topology {
+    static constexpr int n_parts = 25;
+    static constexpr std::array<limb_t, 26> limbs = { {
+        { 1, 8, 0, 1 },
+        { 1, 2, 14, 15 },
+        { 1, 5, 22, 23 },
+        { 2, 3, 16, 17 },
+        { 3, 4, 18, 19 },
+        { 5, 6, 24, 25 },
+        { 6, 7, 26, 27 },
+        { 8, 9, 6, 7 },
+        { 9, 10, 2, 3 },
+        { 10, 11, 4, 5 },
+        { 8, 12, 8, 9 },
+        { 12, 13, 10, 11 },
+        { 13, 14, 12, 13 },
+        { 1, 0, 30, 31 },
+        { 0, 15, 32, 33 },
+        { 15, 17, 36, 37 },
+        { 0, 16, 34, 35 },
+        { 16, 18, 38, 39 },
+        { 2, 17, 20, 21, true },
+        { 5, 18, 28, 29, true },
+        { 14, 19, 40, 41 },
+        { 19, 20, 42, 43 },
+        { 14, 21, 44, 45 },
+        { 11, 22, 46, 47 },
+        { 22, 23, 48, 49 },
+        { 11, 24, 50, 51 },
+    } };
+};
+
+/// \brief Hand topology: 21 key points (the wrist and 4 per finger) and 20 limbs, with PAF channels in limb order.
+struct hand21_topology {
+    static constexpr int n_parts = 21;
+    static constexpr std::array<limb_t, 20> limbs = { {
+        { 0, 1, 0, 1 },
+        { 1, 2, 2, 3 },
+        { 2, 3, 4, 5 },
+        { 3, 4, 6, 7 },
+        { 0, 5, 8, 9 },
+        { 5, 6, 10, 11 },
+        { 6, 7, 12, 13 },
+        { 7, 8, 14, 15 },
+        { 0, 9, 16, 17 },
+        { 9, 10, 18, 19 },
+        { 10, 11, 20, 21 },
+        { 11, 12, 22, 23 },
+        { 0, 13, 24, 25 },
+        { 13, 14, 26, 27 },
+        { 14, 15, 28, 29 },
+        { 15, 16, 30, 31 },
+        { 0, 17, 32, 33 },
+        { 17, 18, 34, 35 },
+        { 18, 19, 36, 37 },
+        { 19, 20, 38, 39 },
+    } };
+};
+
+} // namespace hyperpose
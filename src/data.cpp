@@ -4,10 +4,11 @@
 namespace hyperpose {
 
 
-feature_map_t::feature_map_t(std::string name, std::unique_ptr<char[]>&& tensor, std::vector<int> shape)
+feature_map_t::feature_map_t(std::string name, std::unique_ptr<char[]>&& tensor, std::vector<int> shape, data_type dtype)
     : m_name(std::move(name))
     , m_data(std::move(tensor))
     , m_shape(std::move(shape))
+    , m_dtype(dtype)
 {
 }
 
@@ -1,4 +1,3 @@
-#include "../coco.hpp"
 #include "../logging.hpp"
 #include "fake.hpp"
 #include <hyperpose/operator/parser/paf.hpp>
@@ -7,13 +6,20 @@
 namespace hyperpose {
 namespace parser {
 
-    struct paf::ttl_impl {
+    template <typename Topology>
+    struct basic_paf<Topology>::ttl_impl {
     };
 
-    struct paf::peak_finder_impl {
+    template <typename Topology>
+    struct basic_paf<Topology>::batch_impl {
     };
 
-    paf::paf(float conf_thresh, float paf_thresh, cv::Size resolution_size)
+    template <typename Topology>
+    struct basic_paf<Topology>::video_impl {
+    };
+
+    template <typename Topology>
+    basic_paf<Topology>::basic_paf(float conf_thresh, float paf_thresh, cv::Size resolution_size)
         : m_resolution_size(resolution_size)
         , m_conf_thresh(conf_thresh)
         , m_paf_thresh(paf_thresh)
@@ -21,7 +27,8 @@ namespace parser {
         error_exit_fake();
     }
 
-    paf::paf(const paf& p)
+    template <typename Topology>
+    basic_paf<Topology>::basic_paf(const basic_paf& p)
         : m_resolution_size(p.m_resolution_size)
         , m_conf_thresh(p.m_conf_thresh)
         , m_paf_thresh(p.m_paf_thresh)
@@ -29,24 +36,132 @@ namespace parser {
         error_exit_fake();
     }
 
-    std::vector<human_t> paf::process(const feature_map_t& conf_map, const feature_map_t& paf_map)
+    template <typename Topology>
+    std::vector<typename basic_paf<Topology>::human_type> basic_paf<Topology>::process(const feature_map_t& conf_map, const feature_map_t& paf_map)
     {
-        std::vector<human_t> humans{};
+        std::vector<human_type> humans{};
         error_exit_fake();
         return humans;
     }
 
-    void paf::set_paf_thresh(float thresh)
+    template <typename Topology>
+    std::vector<std::vector<typename basic_paf<Topology>::human_type>> basic_paf<Topology>::process_batch(std::vector<internal_t>& batch)
+    {
+        std::vector<std::vector<human_type>> pose_sets{};
+        error_exit_fake();
+        return pose_sets;
+    }
+
+    template <typename Topology>
+    std::vector<std::vector<typename basic_paf<Topology>::human_type>> basic_paf<Topology>::process_batch(
+        std::vector<internal_t>& batch, std::vector<int>& degradations)
+    {
+        std::vector<std::vector<human_type>> pose_sets{};
+        error_exit_fake();
+        return pose_sets;
+    }
+
+    template <typename Topology>
+    std::vector<std::vector<typename basic_paf<Topology>::human_type>> basic_paf<Topology>::process_thresholds(
+        const feature_map_t& conf_map, const feature_map_t& paf_map, const std::vector<std::pair<float, float>>& thresholds)
+    {
+        std::vector<std::vector<human_type>> pose_sets{};
+        error_exit_fake();
+        return pose_sets;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::prepare(const std::vector<int>& conf_shape, const std::vector<int>& paf_shape, data_type dtype, size_t batch_size)
+    {
+        error_exit_fake();
+    }
+
+    template <typename Topology>
+    double basic_paf<Topology>::warm_up(const std::vector<int>& conf_shape, const std::vector<int>& paf_shape, data_type dtype, size_t batch_size)
+    {
+        error_exit_fake();
+        return 0;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_paf_thresh(float thresh)
     {
         m_paf_thresh = thresh;
     }
 
-    void paf::set_conf_thresh(float thresh)
+    template <typename Topology>
+    void basic_paf<Topology>::set_conf_thresh(float thresh)
     {
         m_conf_thresh = thresh;
     }
 
-    paf::~paf() = default;
+    template <typename Topology>
+    void basic_paf<Topology>::set_smoothing_method(smoothing_method method)
+    {
+        m_smoothing = method;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_sparse_peak_finding(bool sparse)
+    {
+        m_sparse_peak_finding = sparse;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_native_resolution_peak_finding(bool native)
+    {
+        m_native_resolution_peak_finding = native;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_native_resolution_paf_sampling(bool native)
+    {
+        m_native_resolution_paf_sampling = native;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_max_limb_length(float ratio)
+    {
+        m_max_limb_length = ratio;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_max_peaks_per_part(int k)
+    {
+        m_max_peaks_per_part = k;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_regions_of_interest(std::vector<cv::Rect2f> regions)
+    {
+        m_regions_of_interest = std::move(regions);
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_video_mode(int keyframe_interval, float max_motion)
+    {
+        m_keyframe_interval = keyframe_interval;
+        m_max_motion = max_motion;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_time_budget(double milliseconds)
+    {
+        m_time_budget = milliseconds;
+    }
+
+    template <typename Topology>
+    int basic_paf<Topology>::last_degradations() const
+    {
+        return m_last_degradations;
+    }
+
+    template <typename Topology>
+    basic_paf<Topology>::~basic_paf() = default;
+
+    template class basic_paf<coco_topology>;
+    template class basic_paf<body25_topology>;
+    template class basic_paf<hand21_topology>;
 
 } // namespace parser
 
@@ -28,7 +28,7 @@ namespace dnn {
 
     tensorrt::tensorrt(const uff& uff_model, cv::Size input_size,
         int max_batch_size, bool keep_ratio, data_type dtype, double factor,
-        bool flip_rgb)
+        bool flip_rgb, bool half_outputs)
         : m_inp_size(input_size)
         , m_flip_rgb(flip_rgb)
         , m_max_batch_size(max_batch_size)
@@ -52,7 +52,7 @@ namespace dnn {
 
     tensorrt::tensorrt(const onnx& onnx_model, cv::Size input_size,
         int max_batch_size, bool keep_ratio, data_type dtype, double factor,
-        bool flip_rgb)
+        bool flip_rgb, bool half_outputs)
         : m_inp_size(input_size)
         , m_flip_rgb(flip_rgb)
         , m_max_batch_size(max_batch_size)
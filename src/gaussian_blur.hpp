@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "simd.hpp"
+
+namespace hyperpose {
+
+// Same as OpenCV's BORDER_REFLECT_101: gfedcb|abcdefgh|gfedcba
+inline int reflect_101(int p, const int len)
+{
+    if (len == 1)
+        return 0;
+    while (p < 0 || p >= len)
+        p = p < 0 ? -p : 2 * len - 2 - p;
+    return p;
+}
+
+// Same as cv::getGaussianKernel(ksize, sigma, CV_32F).
+inline std::vector<float> gaussian_kernel(const int ksize, const double sigma)
+{
+    std::vector<float> kernel(ksize);
+    const double scale = -0.5 / (sigma * sigma);
+    float sum = 0;
+    for (int i = 0; i < ksize; ++i) {
+        const double x = i - (ksize - 1) * 0.5;
+        kernel[i] = static_cast<float>(std::exp(scale * x * x));
+        sum += kernel[i];
+    }
+    for (auto& v : kernel)
+        v /= sum;
+    return kernel;
+}
+
+// Horizontal pass of a symmetric kernel with `2 * radius + 1` taps.
+// `padded` holds the `n` input values with `radius` border values on both sides.
+inline void symmetric_row_filter(const float* padded, float* out, const int n, const float* kernel, const int radius)
+{
+    using simd::float_v;
+
+    const float* center = padded + radius;
+    int j = 0;
+    for (; j + float_v::width <= n; j += float_v::width) {
+        float_v acc = float_v::load(center + j) * float_v::broadcast(kernel[radius]);
+        for (int i = 1; i <= radius; ++i)
+            acc = acc + (float_v::load(center + j - i) + float_v::load(center + j + i)) * float_v::broadcast(kernel[radius + i]);
+        acc.store(out + j);
+    }
+    for (; j < n; ++j) {
+        float acc = center[j] * kernel[radius];
+        for (int i = 1; i <= radius; ++i)
+            acc += (center[j - i] + center[j + i]) * kernel[radius + i];
+        out[j] = acc;
+    }
+}
+
+// Vertical pass of a symmetric kernel: `taps[i]` points to the row at offset `i - radius`.
+inline void symmetric_column_filter(const float* const* taps, float* out, const int n, const float* kernel, const int radius)
+{
+    using simd::float_v;
+
+    int j = 0;
+    for (; j + float_v::width <= n; j += float_v::width) {
+        float_v acc = float_v::load(taps[radius] + j) * float_v::broadcast(kernel[radius]);
+        for (int i = 1; i <= radius; ++i)
+            acc = acc + (float_v::load(taps[radius - i] + j) + float_v::load(taps[radius + i] + j)) * float_v::broadcast(kernel[radius + i]);
+        acc.store(out + j);
+    }
+    for (; j < n; ++j) {
+        float acc = taps[radius][j] * kernel[radius];
+        for (int i = 1; i <= radius; ++i)
+            acc += (taps[radius - i][j] + taps[radius + i][j]) * kernel[radius + i];
+        out[j] = acc;
+    }
+}
+
+// Rows of a 2D image filtered horizontally on demand and cached in a ring of `2 * radius + 1` rows, which is
+// exactly the set of rows one output row of the vertical pass depends on.
+class gaussian_row_cache {
+public:
+    void reset(const float* image, const int height, const int width, const std::vector<float>& kernel)
+    {
+        reset(image, height, width, kernel, 0, width);
+    }
+
+    // Only columns [col_begin, col_end) of each row are filtered, the rest of the row is still used as border.
+    void reset(const float* image, const int height, const int width, const std::vector<float>& kernel,
+        const int col_begin, const int col_end)
+    {
+        m_image = image;
+        m_height = height;
+        m_width = width;
+        m_col_begin = col_begin;
+        m_cols = col_end - col_begin;
+        m_kernel = kernel.data();
+        m_radius = static_cast<int>(kernel.size()) / 2;
+
+        const int ksize = 2 * m_radius + 1;
+        m_line.resize(m_cols + 2 * m_radius);
+        m_ring.resize(static_cast<size_t>(ksize) * m_cols);
+        m_ring_rows.assign(ksize, -1);
+        m_taps.resize(ksize);
+    }
+
+    int radius() const { return m_radius; }
+
+    // Pointers to the horizontally filtered rows `y - radius, ..., y + radius` (borders reflected).
+    // Each row holds `col_end - col_begin` values.
+    const float* const* taps(const int y)
+    {
+        for (int i = -m_radius; i <= m_radius; ++i)
+            m_taps[i + m_radius] = row(reflect_101(y + i, m_height));
+        return m_taps.data();
+    }
+
+private:
+    const float* row(const int y)
+    {
+        const int slot = y % static_cast<int>(m_ring_rows.size());
+        float* filtered = m_ring.data() + static_cast<size_t>(slot) * m_cols;
+        if (m_ring_rows[slot] != y) {
+            const float* src = m_image + static_cast<size_t>(y) * m_width;
+            // m_line[i] holds column `m_col_begin - m_radius + i`.
+            const int line_begin = m_col_begin - m_radius, line_end = m_col_begin + m_cols + m_radius;
+            const int inner_begin = std::max(line_begin, 0), inner_end = std::min(line_end, m_width);
+            std::copy(src + inner_begin, src + inner_end, m_line.begin() + (inner_begin - line_begin));
+            for (int x = line_begin; x < inner_begin; ++x)
+                m_line[x - line_begin] = src[reflect_101(x, m_width)];
+            for (int x = inner_end; x < line_end; ++x)
+                m_line[x - line_begin] = src[reflect_101(x, m_width)];
+            symmetric_row_filter(m_line.data(), filtered, m_cols, m_kernel, m_radius);
+            m_ring_rows[slot] = y;
+        }
+        return filtered;
+    }
+
+    const float* m_image = nullptr;
+    int m_height = 0, m_width = 0, m_radius = 0;
+    int m_col_begin = 0, m_cols = 0;
+    const float* m_kernel = nullptr;
+
+    std::vector<float> m_line;
+    std::vector<float> m_ring;
+    std::vector<int> m_ring_rows;
+    std::vector<const float*> m_taps;
+};
+
+// Gaussian blur with BORDER_REFLECT_101. Equivalent to cv::GaussianBlur up to float rounding.
+inline void separable_gaussian_blur_2d(const int height, const int width, //
+    const float* input, float* output, const std::vector<float>& kernel, gaussian_row_cache& cache)
+{
+    if (kernel.size() <= 1) {
+        std::copy(input, input + static_cast<size_t>(height) * width, output);
+        return;
+    }
+
+    cache.reset(input, height, width, kernel);
+    for (int y = 0; y < height; ++y)
+        symmetric_column_filter(cache.taps(y), output + static_cast<size_t>(y) * width, width, kernel.data(), cache.radius());
+}
+
+// y[n] = b * x[n] + a1 * y[n - 1] + a2 * y[n - 2] + a3 * y[n - 3]
+struct recursive_gaussian_coefficients {
+    float b, a1, a2, a3;
+};
+
+// I. T. Young, L. J. van Vliet. Recursive implementation of the Gaussian filter. Signal Processing, 1995.
+inline recursive_gaussian_coefficients young_van_vliet(const double sigma)
+{
+    const double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * sigma);
+    const double q2 = q * q, q3 = q2 * q;
+    const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    const double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    const double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    const double b3 = 0.422205 * q3;
+    return { static_cast<float>(1 - (b1 + b2 + b3) / b0),
+        static_cast<float>(b1 / b0), static_cast<float>(b2 / b0), static_cast<float>(b3 / b0) };
+}
+
+// Recursive (IIR) Gaussian blur: a causal and an anti-causal 3rd order pass along each axis. The cost per pixel
+// does not depend on sigma. Borders are extended with the edge value, so only pixels within ~3 sigma of the image
+// border differ noticeably from cv::GaussianBlur (BORDER_REFLECT_101).
+// `line` is a scratch buffer, resized to `max(height, width)` floats. The rows of `input` are `input_stride` floats
+// apart, e.g., to blur a window of a larger image, and the output is `height` x `width`.
+inline void recursive_gaussian_blur_2d(const int height, const int width, const float* input, const size_t input_stride,
+    float* output, const recursive_gaussian_coefficients& c, std::vector<float>& line)
+{
+    using simd::float_v;
+
+    line.resize(std::max(height, width));
+
+    // Horizontal passes, row by row.
+    for (int y = 0; y < height; ++y) {
+        const float* src = input + y * input_stride;
+        float* dst = output + static_cast<size_t>(y) * width;
+
+        float w1 = src[0], w2 = src[0], w3 = src[0];
+        for (int x = 0; x < width; ++x) {
+            const float w = c.b * src[x] + c.a1 * w1 + c.a2 * w2 + c.a3 * w3;
+            w3 = w2, w2 = w1, w1 = w;
+            line[x] = w;
+        }
+
+        w1 = w2 = w3 = line[width - 1];
+        for (int x = width - 1; x >= 0; --x) {
+            const float w = c.b * line[x] + c.a1 * w1 + c.a2 * w2 + c.a3 * w3;
+            w3 = w2, w2 = w1, w1 = w;
+            dst[x] = w;
+        }
+    }
+
+    // Vertical passes, in place, vectorized across columns.
+    const auto row = [output, width](int y) { return output + static_cast<size_t>(y) * width; };
+    const auto vertical_pass = [&](const int begin, const int end, const int step) {
+        std::copy(row(begin), row(begin) + width, line.begin()); // The edge value for border extension.
+        for (int y = begin; y != end; y += step) {
+            const float* p1 = (y - step - begin) * step >= 0 ? row(y - step) : line.data();
+            const float* p2 = (y - 2 * step - begin) * step >= 0 ? row(y - 2 * step) : line.data();
+            const float* p3 = (y - 3 * step - begin) * step >= 0 ? row(y - 3 * step) : line.data();
+            float* cur = row(y);
+
+            int x = 0;
+            for (; x + float_v::width <= width; x += float_v::width)
+                (float_v::broadcast(c.b) * float_v::load(cur + x)
+                    + float_v::broadcast(c.a1) * float_v::load(p1 + x)
+                    + float_v::broadcast(c.a2) * float_v::load(p2 + x)
+                    + float_v::broadcast(c.a3) * float_v::load(p3 + x))
+                    .store(cur + x);
+            for (; x < width; ++x)
+                cur[x] = c.b * cur[x] + c.a1 * p1[x] + c.a2 * p2[x] + c.a3 * p3[x];
+        }
+    };
+
+    vertical_pass(0, height, 1);
+    vertical_pass(height - 1, -1, -1);
+}
+
+inline void recursive_gaussian_blur_2d(const int height, const int width, //
+    const float* input, float* output, const recursive_gaussian_coefficients& c, std::vector<float>& line)
+{
+    recursive_gaussian_blur_2d(height, width, input, width, output, c, line);
+}
+
+} // namespace hyperpose
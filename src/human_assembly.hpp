@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <hyperpose/utility/topology.hpp>
+
+#include "logging.hpp"
+#include "trace.hpp"
+
+struct connection {
+    int cid1;
+    int cid2;
+    float score;
+    int peak_id1;
+    int peak_id2;
+};
+
+struct body_part_ret_t {
+    int id = -1; ///< id of peak in the list of all peaks
+};
+
+template <int J>
+struct human_ref_t_ {
+    int id;
+    body_part_ret_t parts[J];
+    float score;
+    int n_parts;
+
+    human_ref_t_()
+        : id(-1)
+        , score(0)
+        , n_parts(0)
+    {
+    }
+};
+
+namespace hyperpose {
+
+namespace parser {
+
+    constexpr int THRESH_PART_CNT = 4;
+    constexpr float THRESH_HUMAN_SCORE = 0.4;
+
+    // Assembles humans from the connections of all limb types, in the order of `Topology::limbs`.
+    // Each peak keeps the humans it has been assigned to, so the humans touching a connection are found without
+    // scanning all of them. Merged humans are linked with a union-find instead of being erased, so that the indices of
+    // the remaining humans (i.e., their ids) stay valid.
+    // `Peak` is any peak type with a `score`, e.g., `peak_info`.
+    template <typename Topology, typename Peak, typename human_ref_t = human_ref_t_<Topology::n_parts>>
+    std::vector<human_ref_t>
+    get_humans(const std::vector<Peak>& all_peaks,
+        const std::vector<std::vector<connection>>& all_connections)
+    {
+        TRACE_SCOPE(__func__);
+
+        std::vector<human_ref_t> human_refs;
+        std::vector<int> parent; // Union-find over `human_refs`: a merged human points to the human it's merged into.
+
+        const auto find = [&](int h) {
+            while (parent[h] != h)
+                h = parent[h] = parent[parent[h]];
+            return h;
+        };
+
+        // The humans each peak has been assigned to. (Usually one, but overwritten parts are not removed.)
+        thread_local std::vector<std::vector<int>> owners;
+        if (owners.size() < all_peaks.size())
+            owners.resize(all_peaks.size());
+        for (size_t i = 0; i < all_peaks.size(); ++i)
+            owners[i].clear();
+
+        const auto assign = [&](human_ref_t& hr, const int part_id, const int peak_id) {
+            hr.parts[part_id].id = peak_id;
+            owners[peak_id].push_back(hr.id);
+        };
+
+        std::vector<int> hr_ids;
+        for (size_t pair_id = 0; pair_id < Topology::limbs.size(); pair_id++) {
+            const limb_t& limb = Topology::limbs[pair_id];
+            const int part_id1 = limb.part1;
+            const int part_id2 = limb.part2;
+
+            for (const connection& conn : all_connections[pair_id]) {
+                // The humans having `conn.cid1` as `part_id1` or `conn.cid2` as `part_id2`, in the order of creation.
+                hr_ids.clear();
+                const auto collect = [&](const int part_id, const int peak_id) {
+                    for (const int owner : owners[peak_id]) {
+                        const int h = find(owner);
+                        if (human_refs[h].parts[part_id].id == peak_id)
+                            hr_ids.push_back(h);
+                    }
+                };
+                collect(part_id1, conn.cid1);
+                collect(part_id2, conn.cid2);
+                std::sort(hr_ids.begin(), hr_ids.end());
+                hr_ids.erase(std::unique(hr_ids.begin(), hr_ids.end()), hr_ids.end());
+
+                if (hr_ids.size() == 1) {
+                    auto& hr1 = human_refs[hr_ids[0]];
+                    if (hr1.parts[part_id2].id != conn.cid2) {
+                        assign(hr1, part_id2, conn.cid2);
+                        ++hr1.n_parts;
+                        hr1.score += all_peaks[conn.cid2].score + conn.score;
+                    }
+                } else if (hr_ids.size() >= 2) {
+                    auto& hr1 = human_refs[hr_ids[0]];
+                    auto& hr2 = human_refs[hr_ids[1]];
+
+                    bool membership = false;
+                    for (int i = 0; i < Topology::n_parts; ++i) {
+                        if (hr1.parts[i].id >= 0 && hr2.parts[i].id >= 0) {
+                            membership = true;
+                            break;
+                        }
+                    }
+
+                    if (!membership) {
+                        // The peaks of `hr2` still list `hr2` as their owner, which `find` resolves to `hr1`.
+                        for (int i = 0; i < Topology::n_parts; i++)
+                            if (hr2.parts[i].id >= 0)
+                                hr1.parts[i].id = hr2.parts[i].id;
+
+                        hr1.n_parts += hr2.n_parts;
+                        hr1.score += hr2.score;
+                        hr1.score += conn.score;
+
+                        parent[hr2.id] = hr1.id;
+                    } else {
+                        assign(hr1, part_id2, conn.cid2);
+                        hr1.n_parts += 1;
+                        hr1.score += all_peaks[conn.cid2].score + conn.score;
+                    }
+                } else if (hr_ids.size() == 0 && !limb.is_virtual) {
+                    human_ref_t h;
+                    h.id = human_refs.size();
+                    h.n_parts = 2;
+                    h.score = all_peaks[conn.cid1].score + all_peaks[conn.cid2].score + conn.score;
+
+                    human_refs.push_back(h);
+                    parent.push_back(h.id);
+                    assign(human_refs.back(), part_id1, conn.cid1);
+                    assign(human_refs.back(), part_id2, conn.cid2);
+                }
+            }
+        }
+
+        // Drop the merged humans.
+        human_refs.erase(std::remove_if(human_refs.begin(), human_refs.end(),
+                             [&](const human_ref_t& hr) { return parent[hr.id] != hr.id; }),
+            human_refs.end());
+
+        info("got ", human_refs.size(), " incomplete humans\n");
+
+        human_refs.erase(std::remove_if(human_refs.begin(), human_refs.end(),
+                             [&](const human_ref_t& hr) {
+                                 return (hr.n_parts < THRESH_PART_CNT || hr.score / hr.n_parts < THRESH_HUMAN_SCORE);
+                             }),
+            human_refs.end());
+        return human_refs;
+    }
+}
+
+} // namespace hyperpose
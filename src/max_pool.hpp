@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+
+#include "simd.hpp"
+
+namespace hyperpose {
+
+// Reference implementation: 3x3 max pooling with "SAME" padding, out-of-range neighbours are ignored.
+template <typename T>
+void same_max_pool_3x3_2d(const int height, const int width, //
+    const T* input, T* output)
+{
+    const auto at = [width](int i, int j) { return i * width + j; };
+
+    for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+            const int p_index = at(i, j);
+            float max_val = input[p_index];
+            for (int dx = 0; dx < 3; ++dx) {
+                for (int dy = 0; dy < 3; ++dy) {
+                    const int nx = i + dx - 1;
+                    const int ny = j + dy - 1;
+                    if (0 <= nx && nx < height && 0 <= ny && ny < width) {
+                        max_val = std::max(max_val, input[at(nx, ny)]);
+                    }
+                }
+            }
+            output[p_index] = max_val;
+        }
+    }
+}
+
+// out[j] = max(a[j], b[j], c[j])
+inline void max3_rows(const float* a, const float* b, const float* c, float* out, const int n)
+{
+    using simd::float_v;
+
+    int j = 0;
+    for (; j + float_v::width <= n; j += float_v::width)
+        max(max(float_v::load(a + j), float_v::load(b + j)), float_v::load(c + j)).store(out + j);
+    for (; j < n; ++j)
+        out[j] = std::max(std::max(a[j], b[j]), c[j]);
+}
+
+// out[j] = max(in[j - 1], in[j], in[j + 1]), neighbours out of [0, n) are ignored.
+// `in` and `out` must not alias.
+inline void max3_neighbours(const float* in, float* out, const int n)
+{
+    using simd::float_v;
+
+    if (n == 1) {
+        out[0] = in[0];
+        return;
+    }
+
+    out[0] = std::max(in[0], in[1]);
+    int j = 1;
+    for (; j + float_v::width <= n - 1; j += float_v::width)
+        max(max(float_v::load(in + j - 1), float_v::load(in + j)), float_v::load(in + j + 1)).store(out + j);
+    for (; j < n - 1; ++j)
+        out[j] = std::max(std::max(in[j - 1], in[j]), in[j + 1]);
+    out[n - 1] = std::max(in[n - 2], in[n - 1]);
+}
+
+// Separable version of `same_max_pool_3x3_2d`: a vertical 3-max over rows (i - 1, i, i + 1) followed by a
+// horizontal 3-max. The result is bit-identical to the reference implementation.
+// `column_max` is a scratch buffer of `width` floats.
+inline void same_max_pool_3x3_2d_simd(const int height, const int width, //
+    const float* input, float* output, float* column_max)
+{
+    for (int i = 0; i < height; ++i) {
+        const float* above = input + std::max(i - 1, 0) * width;
+        const float* row = input + i * width;
+        const float* below = input + std::min(i + 1, height - 1) * width;
+        max3_rows(above, row, below, column_max, width);
+        max3_neighbours(column_max, output + i * width, width);
+    }
+}
+
+} // namespace hyperpose
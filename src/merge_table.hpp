@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <hyperpose/utility/human.hpp>
+
+namespace hyperpose {
+
+// An open-addressed hash table from the key points(part type and position) to the humans they belong to, to merge
+// the humans sharing key points. The slots are hashed by the part type and the cell of a 64 x 64 grid the key point
+// falls in, and probed linearly. It's kept by the parser: a slot is empty unless it's stamped with the current
+// generation, so clearing it for the next image is O(1) and frees nothing.
+// A merged human forwards to the human it's merged into(`merged_into`), so the slots of the key points it brings are
+// not updated. A slot whose human(after forwarding) doesn't hold the key point any more is free again.
+struct merge_table {
+    struct slot {
+        float x, y;
+        int part, human;
+        std::uint32_t generation = 0;
+    };
+
+    std::vector<slot> slots;
+    std::uint32_t generation = 0;
+    std::vector<int> merged_into;
+
+    // Clears the table to hold up to `n_key_points` key points of `n_humans` humans.
+    void clear(const size_t n_key_points, const size_t n_humans)
+    {
+        merged_into.resize(n_humans);
+        std::iota(merged_into.begin(), merged_into.end(), 0);
+
+        size_t capacity = 64;
+        while (capacity < 2 * n_key_points) // Load factor <= 0.5.
+            capacity *= 2;
+        if (slots.size() < capacity || ++generation == 0) {
+            slots.assign(std::max(capacity, slots.size()), slot{});
+            generation = 1;
+        }
+    }
+
+    // The slot of the key point, which is taken by `human` if the key point is not in the table yet.
+    slot& emplace(const int part, const body_part_t& p, const int human)
+    {
+        constexpr int grid_size = 64;
+        const auto cell = [](const float v) { return std::clamp(static_cast<int>(v * grid_size), 0, grid_size - 1); };
+        const std::uint32_t key = (part * grid_size + cell(p.y)) * grid_size + cell(p.x);
+        const size_t mask = slots.size() - 1;
+        for (size_t i = (key * 2654435761u) & mask;; i = (i + 1) & mask) {
+            auto& s = slots[i];
+            if (s.generation != generation) {
+                s = { p.x, p.y, part, human, generation };
+                return s;
+            }
+            if (s.part == part && s.x == p.x && s.y == p.y)
+                return s;
+        }
+    }
+
+    // The human that `human` is merged into.
+    int find(int human)
+    {
+        while (merged_into[human] != human)
+            human = merged_into[human] = merged_into[merged_into[human]];
+        return human;
+    }
+};
+
+// Merges the humans in order: each one is merged into the first(lowest index) human before it which holds its first
+// shared key point(in part order). The merged humans are left as tombstones(score 0). The humans having all the
+// `n_key_points` key points are neither merged nor merged into. Returns the number of merged humans.
+template <size_t J>
+size_t merge_humans(std::vector<human_t_<J>>& humans, merge_table& table, const size_t n_key_points)
+{
+    size_t n_table_points = 0;
+    for (const auto& human : humans)
+        n_table_points += static_cast<size_t>(human.score);
+    table.clear(n_table_points, humans.size());
+
+    // Registers `human` for the key point, unless a human of a lower index is registered and still holds it. Returns the
+    // registered one.
+    const auto claim = [&](const size_t part, const body_part_t& p, const int human) {
+        auto& s = table.emplace(part, p, human);
+        const int holder = table.find(s.human);
+        const auto& held = humans[holder].parts[part];
+        if (!held.has_value || held.x != p.x || held.y != p.y || human < holder)
+            s.human = human;
+        return table.find(s.human);
+    };
+
+    size_t n_merged = 0;
+    for (size_t i = 0; i < humans.size(); ++i) {
+        auto& cur_human = humans[i]; // We are trying to find other parts for current human.
+        if (cur_human.score > n_key_points - 0.1)
+            continue;
+
+        for (size_t j = 0; j < cur_human.parts.size(); ++j) {
+            const auto& this_part = cur_human.parts[j]; // Current part: Unique Or Belong to Others.
+            if (!this_part.has_value)
+                continue;
+
+            const int owner = claim(j, this_part, i);
+            if (owner == static_cast<int>(i))
+                continue;
+
+            // Move the current human to the first human holding a key point of it. The key points it registered
+            // before are forwarded to the owner, and the later ones are registered for the owner if it takes them.
+            auto& maybe_combine = humans[owner];
+            for (size_t u = 0; u < cur_human.parts.size(); ++u) {
+                const auto& cur_part = cur_human.parts[u];
+                if (!cur_part.has_value || maybe_combine.parts[u].has_value)
+                    continue;
+                maybe_combine.parts[u] = cur_part;
+                maybe_combine.score += 1.0;
+                if (u > j)
+                    claim(u, cur_part, owner);
+            }
+
+            cur_human.score = 0;
+            table.merged_into[i] = owner;
+            ++n_merged;
+            break;
+        }
+    }
+    return n_merged;
+}
+
+} // namespace hyperpose
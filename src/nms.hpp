@@ -0,0 +1,51 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "simd.hpp"
+
+namespace hyperpose {
+
+// Bounding boxes as SoA (structure of arrays), padded by one SIMD width so that the IoU kernel needs no scalar tail.
+struct nms_boxes {
+    std::vector<float> x0, y0, x1, y1, area;
+    std::vector<float> suppressed; // 1.0f for the suppressed boxes.
+
+    void assign(const size_t n)
+    {
+        for (auto* v : { &x0, &y0, &x1, &y1, &area, &suppressed })
+            v->assign(n + simd::float_v::width, 0.f);
+    }
+
+    void set(const size_t i, const cv::Rect& r)
+    {
+        x0[i] = r.x, y0[i] = r.y, x1[i] = r.x + r.width, y1[i] = r.y + r.height, area[i] = r.area();
+    }
+
+    // Greedy NMS over `n` boxes sorted by confidence (descending): a box is suppressed if a box kept before it
+    // overlaps it with IoU >= `thresh`. Each kept box is compared with all the later ones at once.
+    void suppress(const size_t n, const float thresh)
+    {
+        using simd::float_v;
+        const auto zero = float_v::broadcast(0.f), one = float_v::broadcast(1.f), t = float_v::broadcast(thresh);
+        for (size_t i = 0; i < n; ++i) {
+            if (suppressed[i] != 0.f)
+                continue;
+            const auto bx0 = float_v::broadcast(x0[i]), by0 = float_v::broadcast(y0[i]);
+            const auto bx1 = float_v::broadcast(x1[i]), by1 = float_v::broadcast(y1[i]);
+            const auto ba = float_v::broadcast(area[i]);
+            for (size_t j = i + 1; j < n; j += float_v::width) {
+                const auto iw = max(zero, min(bx1, float_v::load(&x1[j])) - max(bx0, float_v::load(&x0[j])));
+                const auto ih = max(zero, min(by1, float_v::load(&y1[j])) - max(by0, float_v::load(&y0[j])));
+                const auto inter = iw * ih;
+                const auto uni = ba + float_v::load(&area[j]) - inter;
+                // IoU >= thresh, i.e., !(thresh * union > intersection), for a non-empty union.
+                const auto hit = (one - greater(t * uni, inter)) * greater(uni, zero);
+                max(float_v::load(&suppressed[j]), hit).store(&suppressed[j]);
+            }
+        }
+    }
+};
+
+} // namespace hyperpose
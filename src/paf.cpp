@@ -1,48 +1,24 @@
-#include "coco.hpp"
+#include "human_assembly.hpp"
 #include "logging.hpp"
 #include "post_process.hpp"
+#include "simd.hpp"
+#include "spatial_grid.hpp"
+#include "time_budget.hpp"
+#include "worker_buffers.hpp"
 #include <hyperpose/operator/parser/paf.hpp>
+#include <hyperpose/utility/combinable.hpp>
+#include <chrono>
+#include <functional>
+#include <numeric>
+#include <optional>
 #include <thread>
 
-struct connection {
-    int cid1;
-    int cid2;
-    float score;
-    int peak_id1;
-    int peak_id2;
-};
-
-struct body_part_ret_t {
-    int id = -1; ///< id of peak in the list of all peaks
-};
-
-template <int J>
-struct human_ref_t_ {
-    int id;
-    body_part_ret_t parts[J];
-    float score;
-    int n_parts;
-
-    human_ref_t_()
-        : id(-1)
-        , score(0)
-        , n_parts(0)
-    {
-    }
-
-    inline bool touches(const std::pair<int, int>& p, const connection& conn) const
-    {
-        return parts[p.first].id == conn.cid1 || parts[p.second].id == conn.cid2;
-    }
-};
-
-using human_ref_t = human_ref_t_<hyperpose::COCO_N_PARTS>;
-
 struct connection_candidate {
     int idx1;
     int idx2;
     float score;
     float etc;
+    float paf_bound; ///< The limb passes any PAF threshold below this. (Only computed for `process_thresholds`)
 };
 
 inline bool operator>(const connection_candidate& a, const connection_candidate& b)
@@ -55,8 +31,6 @@ namespace hyperpose {
 namespace parser {
 
     constexpr int THRESH_VECTOR_CNT1 = 8;
-    constexpr int THRESH_PART_CNT = 4;
-    constexpr float THRESH_HUMAN_SCORE = 0.4;
     constexpr int STEP_PAF = 10;
 
     struct VectorXY {
@@ -64,182 +38,211 @@ namespace parser {
         float y;
     };
 
-    static std::vector<VectorXY>
-    get_paf_vectors(const ttl::tensor_view<float, 3>& pafmap,
-        const int& ch_id1, //
-        const int& ch_id2, //
-        const point_2d<int>& peak1, //
-        const point_2d<int>& peak2)
-    {
-        auto roundpaf = [](float v) { return static_cast<int>(v + 0.5); };
-        std::vector<VectorXY> paf_vectors;
-
-        const float STEP_X = (peak2.x - peak1.x) / float(STEP_PAF);
-        const float STEP_Y = (peak2.y - peak1.y) / float(STEP_PAF);
+    // Reads PAF vectors at (x, y) coordinates of the `m_resolution_size` map: either from the upsampled PAF map, or
+    // from the original one with bilinear interpolation.
+    struct paf_sampler {
+        ttl::tensor_view<float, 3> pafmap;
+        bool bilinear;
+        float scale_x, scale_y; // The size of the `m_resolution_size` map over the size of `pafmap`.
 
-        for (int i : ttl::range(STEP_PAF)) {
-            int location_x = roundpaf(peak1.x + i * STEP_X);
-            int location_y = roundpaf(peak1.y + i * STEP_Y);
-
-            VectorXY v;
-            v.x = pafmap.at(ch_id1, location_y, location_x);
-            v.y = pafmap.at(ch_id2, location_y, location_x);
-            paf_vectors.push_back(v);
-        }
-
-        return paf_vectors;
-    }
-
-    static std::vector<connection_candidate>
-    get_connection_candidates(const ttl::tensor_view<float, 3>& pafmap,
-        const std::vector<peak_info>& all_peaks,
-        const std::vector<int>& peak_index_1,
-        const std::vector<int>& peak_index_2,
-        const std::pair<int, int> coco_pair_net, int height, float paf_thresh)
-    {
-        std::vector<connection_candidate> candidates{};
-
-        const auto maybe_add = [&](const peak_info& peak_a, const peak_info& peak_b) {
-            const auto dis = peak_b.pos - peak_a.pos;
-            const float norm = std::sqrt(dis.l2());
-            if (norm < 1e-12) {
-                return;
+        VectorXY operator()(const int ch_id1, const int ch_id2, const float x, const float y) const
+        {
+            if (!bilinear) {
+                auto roundpaf = [](float v) { return static_cast<int>(v + 0.5); };
+                const int location_x = roundpaf(x), location_y = roundpaf(y);
+                return { pafmap.at(ch_id1, location_y, location_x), pafmap.at(ch_id2, location_y, location_x) };
             }
-            point_2d<float> vec = dis.cast_to<float>();
-            vec.x /= norm;
-            vec.y /= norm;
-
-            const std::vector<VectorXY> paf_vecs = get_paf_vectors(pafmap, //
-                coco_pair_net.first, //
-                coco_pair_net.second, //
-                peak_a.pos, peak_b.pos);
 
-            float scores = 0.0f;
+            const auto [channel, height, width] = pafmap.dims();
+            // Pixel `p` of the original map covers the pixels [p * scale, (p + 1) * scale) of the resized one.
+            const float u = std::clamp((x + 0.5f) / scale_x - 0.5f, 0.f, static_cast<float>(width - 1));
+            const float v = std::clamp((y + 0.5f) / scale_y - 0.5f, 0.f, static_cast<float>(height - 1));
+            const int x0 = static_cast<int>(u), y0 = static_cast<int>(v);
+            const int x1 = std::min<int>(x0 + 1, width - 1), y1 = std::min<int>(y0 + 1, height - 1);
+            const float fx = u - x0, fy = v - y0;
+
+            const auto sample = [&](const int ch) {
+                const float top = pafmap.at(ch, y0, x0) * (1 - fx) + pafmap.at(ch, y0, x1) * fx;
+                const float bottom = pafmap.at(ch, y1, x0) * (1 - fx) + pafmap.at(ch, y1, x1) * fx;
+                return top * (1 - fy) + bottom * fy;
+            };
+            return { sample(ch_id1), sample(ch_id2) };
+        }
+    };
 
-            // criterion 1 : score treshold count
-            int criterion1 = 0;
-            for (int i = 0; i < STEP_PAF; i++) {
-                const float score = vec.x * paf_vecs[i].x + vec.y * paf_vecs[i].y;
-                scores += score;
+    // The peaks of one part channel in structure-of-arrays layout.
+    struct peak_soa {
+        std::vector<int> id;
+        std::vector<int> x, y; // Integer positions.
+        std::vector<float> sample_x, sample_y; // Positions to sample the PAF from.
+        std::vector<int> track; // The previous human near each peak in the video mode, or -1.
 
-                if (score > paf_thresh)
-                    criterion1 += 1;
+        // `tracks` (indexed by peak id) is empty out of the video mode.
+        void assign(const paf_sampler& sampler, const std::vector<peak_info>& all_peaks, const std::vector<int>& peak_ids,
+            const std::vector<int>& tracks)
+        {
+            const size_t n = peak_ids.size();
+            id.assign(peak_ids.begin(), peak_ids.end());
+            track.resize(n);
+            x.resize(n);
+            y.resize(n);
+            sample_x.resize(n);
+            sample_y.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                const peak_info& peak = all_peaks[peak_ids[i]];
+                x[i] = peak.pos.x;
+                y[i] = peak.pos.y;
+                // The bilinear sampler reads the PAF at the exact (sub-pixel) peak positions.
+                const auto position = sampler.bilinear ? peak.refined_pos : peak.pos.cast_to<float>();
+                sample_x[i] = position.x;
+                sample_y[i] = position.y;
+                track[i] = tracks.empty() ? -1 : tracks[peak_ids[i]];
             }
+        }
 
-            float criterion2 = scores / STEP_PAF + std::min(0.0, 0.5 * height / norm - 1.0);
-
-            if (criterion1 > THRESH_VECTOR_CNT1 && criterion2 > 0)
-                candidates.push_back(
-                    { /*candidate.idx1 =*/peak_a.id,
-                        /*candidate.idx2 =*/peak_b.id,
-                        /*candidate.score =*/criterion2,
-                        /*candidate.etc =*/criterion2 + peak_a.score + peak_b.score });
-        };
-
-        for (auto id1 : peak_index_1)
-            for (auto idx2 : peak_index_2)
-                maybe_add(all_peaks[id1], all_peaks[idx2]);
+        size_t size() const { return id.size(); }
+    };
 
-        return candidates;
-    }
+    // Per-thread buffers of `get_connections`, reused across limb types and images.
+    struct limb_scratch {
+        peak_soa peaks_a, peaks_b;
+        std::vector<size_t> nearby;
+        spatial_grid grid;
+        std::vector<connection_candidate> candidates;
+    };
 
-    static std::vector<human_ref_t>
-    get_humans(const std::vector<peak_info>& all_peaks,
-        const std::vector<std::vector<connection>>& all_connections)
+    // Scores the limbs from one peak of the first part to `float_v::width` peaks of the second one at a time: the PAF
+    // vectors of all lanes are sampled step by step and projected onto the limb directions with SIMD. A lane stops
+    // being sampled once it misses `THRESH_VECTOR_CNT1` and the whole batch stops once every lane does.
+    // The PAF is sampled `n_steps` times along each limb. (`STEP_PAF`, unless the time budget is short)
+    // With `bound_paf`, each candidate also gets the highest PAF threshold it would pass. (`paf_bound`)
+    // Limbs longer than `max_limb_length` (if > 0), or between the peaks near different previous humans (`tracks`, in
+    // the video mode) are not scored at all.
+    static void
+    get_connection_candidates(limb_scratch& scratch, const paf_sampler& sampler,
+        const std::vector<peak_info>& all_peaks, const std::vector<int>& tracks,
+        const std::vector<int>& peak_index_1,
+        const std::vector<int>& peak_index_2,
+        const limb_t& limb, int height, float paf_thresh, float max_limb_length, int n_steps, bool bound_paf)
     {
-        TRACE_SCOPE(__func__);
-
-        std::vector<human_ref_t> human_refs;
-        for (int pair_id = 0; pair_id < COCO_N_PAIRS; pair_id++) {
-            // printf("pair_id: %d, has %lu connections\n", pair_id,
-            //        all_connections[pair_id].size());
+        using simd::float_v;
+        constexpr int W = float_v::width;
+        // A limb must pass `paf_thresh` in more than `THRESH_VECTOR_CNT1` of `STEP_PAF` samples. (In proportion)
+        const int max_misses = n_steps - THRESH_VECTOR_CNT1 * n_steps / STEP_PAF - 1;
+
+        auto& [peaks_a, peaks_b, nearby, grid, candidates] = scratch;
+        candidates.clear();
+        if (peak_index_1.empty() || peak_index_2.empty())
+            return;
+
+        peaks_a.assign(sampler, all_peaks, peak_index_1, tracks);
+        peaks_b.assign(sampler, all_peaks, peak_index_2, tracks);
+
+        // The peaks of the second part to pair with the current peak of the first part: all of them, or only the ones
+        // within `max_limb_length` if it's set.
+        const bool pruning = max_limb_length > 0, seeded = !tracks.empty();
+        if (pruning)
+            grid.build(peaks_b.sample_x.data(), peaks_b.sample_y.data(), peaks_b.size(), max_limb_length);
+
+        float norm[W], vec_x[W], vec_y[W], step_x[W], step_y[W], paf_x[W], paf_y[W], hits[W], scores[W];
+        float step_scores[STEP_PAF][W], lane_scores[STEP_PAF];
+        int misses[W];
+        bool alive[W];
+
+        for (size_t a = 0; a < peaks_a.size(); ++a) {
+            if (pruning) {
+                nearby.clear();
+                grid.query(peaks_a.sample_x[a], peaks_a.sample_y[a], max_limb_length, nearby);
+            } else if (a == 0 || seeded) {
+                nearby.resize(peaks_b.size());
+                std::iota(nearby.begin(), nearby.end(), 0);
+            }
+            if (const int track = peaks_a.track[a]; track >= 0)
+                nearby.erase(std::remove_if(nearby.begin(), nearby.end(),
+                                 [&](const size_t b) { return peaks_b.track[b] >= 0 && peaks_b.track[b] != track; }),
+                    nearby.end());
+
+            for (size_t b_begin = 0; b_begin < nearby.size(); b_begin += W) {
+                const int n_lanes = std::min<size_t>(W, nearby.size() - b_begin);
+
+                int n_alive = 0;
+                for (int l = 0; l < W; ++l) {
+                    alive[l] = false;
+                    vec_x[l] = vec_y[l] = paf_x[l] = paf_y[l] = 0;
+                    if (l >= n_lanes)
+                        continue;
+
+                    const size_t b = nearby[b_begin + l];
+                    const int dis_x = peaks_b.x[b] - peaks_a.x[a], dis_y = peaks_b.y[b] - peaks_a.y[a];
+                    norm[l] = std::sqrt(dis_x * dis_x + dis_y * dis_y);
+                    if (norm[l] < 1e-12)
+                        continue;
+
+                    vec_x[l] = dis_x / norm[l];
+                    vec_y[l] = dis_y / norm[l];
+                    step_x[l] = (peaks_b.sample_x[b] - peaks_a.sample_x[a]) / float(n_steps);
+                    step_y[l] = (peaks_b.sample_y[b] - peaks_a.sample_y[a]) / float(n_steps);
+                    misses[l] = 0;
+                    alive[l] = true;
+                    ++n_alive;
+                }
 
-            const auto coco_pair = COCOPAIRS[pair_id];
-            const int part_id1 = coco_pair.first;
-            const int part_id2 = coco_pair.second;
+                const float_v vx = float_v::load(vec_x), vy = float_v::load(vec_y), thresh = float_v::broadcast(paf_thresh);
+                float_v score_sum = float_v::broadcast(0);
+                for (int i = 0; i < n_steps && n_alive > 0; ++i) {
+                    for (int l = 0; l < n_lanes; ++l)
+                        if (alive[l]) {
+                            const VectorXY v = sampler(limb.paf_x, limb.paf_y,
+                                peaks_a.sample_x[a] + i * step_x[l], peaks_a.sample_y[a] + i * step_y[l]);
+                            paf_x[l] = v.x;
+                            paf_y[l] = v.y;
+                        }
 
-            for (const connection& conn : all_connections[pair_id]) {
-                std::vector<int> hr_ids;
+                    const float_v score = vx * float_v::load(paf_x) + vy * float_v::load(paf_y);
+                    score_sum = score_sum + score;
+                    if (bound_paf)
+                        score.store(step_scores[i]);
+                    greater(score, thresh).store(hits);
 
-                for (auto hr : human_refs) {
-                    if (hr.touches(coco_pair, conn)) {
-                        hr_ids.push_back(hr.id);
-                    }
-                }
-                // printf("%lu humans touches this connection\n",
-                // hr_ids.size());
-
-                if (hr_ids.size() == 1) {
-                    auto& hr1 = human_refs[hr_ids[0]];
-                    if (hr1.parts[part_id2].id != conn.cid2) {
-                        hr1.parts[part_id2].id = conn.cid2;
-                        ++hr1.n_parts;
-                        hr1.score += all_peaks[conn.cid2].score + conn.score;
-                    }
-                } else if (hr_ids.size() >= 2) {
-                    auto& hr1 = human_refs[hr_ids[0]];
-                    auto& hr2 = human_refs[hr_ids[1]];
-
-                    int membership = 0;
-                    for (int i = 0; i < COCO_N_PARTS; ++i) {
-                        if (hr1.parts[i].id > 0 && hr2.parts[i].id > 0) {
-                            membership = 2;
+                    for (int l = 0; l < n_lanes; ++l)
+                        if (alive[l] && hits[l] == 0 && ++misses[l] > max_misses) {
+                            alive[l] = false;
+                            --n_alive;
                         }
-                    }
+                }
 
-                    if (membership == 0) {
-                        for (int i = 0; i < COCO_N_PARTS; i++) {
-                            // FIXME: double check!
-                            hr1.parts[i].id += hr2.parts[i].id + 1;
+                if (n_alive == 0)
+                    continue;
+
+                score_sum.store(scores);
+                for (int l = 0; l < n_lanes; ++l)
+                    if (alive[l]) {
+                        const float criterion2 = scores[l] / n_steps + std::min(0.0, 0.5 * height / norm[l] - 1.0);
+                        if (criterion2 > 0) {
+                            // A threshold passes if it's below all but `max_misses` samples.
+                            float paf_bound = 0;
+                            if (bound_paf) {
+                                for (int i = 0; i < n_steps; ++i)
+                                    lane_scores[i] = step_scores[i][l];
+                                std::nth_element(lane_scores, lane_scores + max_misses, lane_scores + n_steps);
+                                paf_bound = lane_scores[max_misses];
+                            }
+                            const int id1 = peaks_a.id[a], id2 = peaks_b.id[nearby[b_begin + l]];
+                            candidates.push_back(
+                                { /*candidate.idx1 =*/id1,
+                                    /*candidate.idx2 =*/id2,
+                                    /*candidate.score =*/criterion2,
+                                    /*candidate.etc =*/criterion2 + all_peaks[id1].score + all_peaks[id2].score,
+                                    /*candidate.paf_bound =*/paf_bound });
                         }
-
-                        hr1.n_parts += hr2.n_parts;
-                        hr1.score += hr2.score;
-                        hr1.score += conn.score;
-
-                        human_refs.erase(human_refs.begin() + hr_ids[1]);
-                    } else {
-                        hr1.parts[part_id2].id = conn.cid2;
-                        hr1.n_parts += 1;
-                        hr1.score += all_peaks[conn.cid2].score + conn.score;
                     }
-                } else if (hr_ids.size() == 0 && !is_virtual_pair(pair_id)) {
-                    human_ref_t h;
-                    h.parts[part_id1].id = conn.cid1;
-                    h.parts[part_id2].id = conn.cid2;
-                    h.n_parts = 2;
-                    h.score = all_peaks[conn.cid1].score + all_peaks[conn.cid2].score + conn.score;
-                    h.id = human_refs.size();
-
-                    human_refs.push_back(h);
-                }
             }
         }
-
-        info("got ", human_refs.size(), " incomplete humans\n");
-
-        human_refs.erase(std::remove_if(human_refs.begin(), human_refs.end(),
-                             [&](const human_ref_t& hr) {
-                                 return (hr.n_parts < THRESH_PART_CNT || hr.score / hr.n_parts < THRESH_HUMAN_SCORE);
-                             }),
-            human_refs.end());
-        return human_refs;
     }
 
-    static std::vector<connection>
-    get_connections(const ttl::tensor_view<float, 3>& pafmap,
-        const std::vector<peak_info>& all_peaks,
-        const std::vector<std::vector<int>>& peak_ids_by_channel,
-        int pair_id, int height, float paf_thresh)
+    // Keep the best scoring candidates first, unless one of their peaks is already connected.
+    static std::vector<connection> select_connections(std::vector<connection_candidate>& candidates)
     {
-        const auto coco_pair = COCOPAIRS[pair_id];
-        const auto coco_pair_net = COCOPAIRS_NET[pair_id];
-
-        std::vector<connection_candidate> candidates = get_connection_candidates(
-            pafmap, all_peaks, //
-            peak_ids_by_channel[coco_pair.first],
-            peak_ids_by_channel[coco_pair.second], coco_pair_net, height, paf_thresh);
-
         // nms
         std::sort(candidates.begin(), candidates.end(),
             std::greater<connection_candidate>());
@@ -266,17 +269,351 @@ namespace parser {
         return conns;
     }
 
-    // Class paf.
-    struct paf::peak_finder_impl : public peak_finder_t<float> {
+    static std::vector<connection>
+    get_connections(limb_scratch& scratch, const paf_sampler& sampler,
+        const std::vector<peak_info>& all_peaks, const std::vector<int>& tracks,
+        const std::vector<std::vector<int>>& peak_ids_by_channel,
+        const limb_t& limb, int height, float paf_thresh, float max_limb_length, int n_steps)
+    {
+        get_connection_candidates(scratch, sampler, all_peaks, tracks, //
+            peak_ids_by_channel[limb.part1],
+            peak_ids_by_channel[limb.part2], limb, height, paf_thresh, max_limb_length, n_steps, false);
+        return select_connections(scratch.candidates);
+    }
+
+    // The humans in coordinates relative to the `resolution` sized map.
+    template <typename Topology, typename human_ref_t>
+    static std::vector<human_t_<Topology::n_parts>>
+    to_humans(const std::vector<human_ref_t>& human_refs, const std::vector<peak_info>& all_peaks, const cv::Size resolution)
+    {
+        info("Got ", human_refs.size(), " humans\n");
+
+        std::vector<human_t_<Topology::n_parts>> humans;
+        humans.reserve(human_refs.size());
+        for (const auto& hr : human_refs) {
+            human_t_<Topology::n_parts> human;
+            human.score = hr.score;
+            for (int i = 0; i < Topology::n_parts; ++i) {
+                if (hr.parts[i].id != -1) {
+                    human.parts[i].has_value = true;
+                    const auto p = all_peaks[hr.parts[i].id];
+                    human.parts[i].score = p.score;
+                    human.parts[i].x = p.refined_pos.x / resolution.width;
+                    human.parts[i].y = p.refined_pos.y / resolution.height;
+                }
+            }
+            humans.push_back(human);
+        }
+        return humans;
+    }
+
+    // Keep the `k` highest scoring peaks of each channel (in their original order).
+    static void keep_top_k_peaks(std::vector<std::vector<int>>& peak_ids_by_channel, const std::vector<peak_info>& all_peaks, const size_t k)
+    {
+        for (auto& peak_ids : peak_ids_by_channel) {
+            if (peak_ids.size() <= k)
+                continue;
+            std::nth_element(peak_ids.begin(), peak_ids.begin() + k, peak_ids.end(), [&](int a, int b) {
+                return all_peaks[a].score > all_peaks[b].score || (all_peaks[a].score == all_peaks[b].score && a < b);
+            });
+            peak_ids.resize(k);
+            std::sort(peak_ids.begin(), peak_ids.end());
+        }
+    }
+
+    // The shortcuts `get_connections` takes to fit the time budget.
+    struct connection_plan {
+        int max_peaks_per_part = 0; // 0: unlimited.
+        int n_steps = STEP_PAF;
+        bool skip_virtual = false;
+        size_t n_limbs; // Only the first `n_limbs` limb types are connected.
+        int degradations = degradation::kNONE;
+    };
+
+    // Below this, capping the peaks would drop people rather than noise, so the cheaper stages are tried first.
+    constexpr int MIN_BUDGET_PEAKS_PER_PART = 8;
+
+    // The work of a plan: the (upper bound of) PAF samples to score the limbs.
+    template <typename Topology>
+    static double connection_units(const std::vector<std::vector<int>>& peak_ids_by_channel, const connection_plan& plan)
+    {
+        const auto n_peaks = [&](const int part) {
+            const size_t n = peak_ids_by_channel[part].size();
+            return static_cast<double>(plan.max_peaks_per_part > 0 ? std::min<size_t>(n, plan.max_peaks_per_part) : n);
+        };
+        double pairs = 0;
+        for (size_t i = 0; i < plan.n_limbs; ++i) {
+            const limb_t& limb = Topology::limbs[i];
+            if (!(plan.skip_virtual && limb.is_virtual))
+                pairs += n_peaks(limb.part1) * n_peaks(limb.part2);
+        }
+        return pairs * plan.n_steps;
+    }
+
+    // Degrade the connection stage until it's predicted to fit in `remaining_ms`: cap the peaks per part, sample the
+    // PAF less, skip the virtual limbs and, at last, only connect the first limb types.
+    template <typename Topology>
+    static connection_plan plan_connections(const std::vector<std::vector<int>>& peak_ids_by_channel,
+        const cost_model& model, const double remaining_ms)
+    {
+        connection_plan plan;
+        plan.n_limbs = Topology::limbs.size();
+        if (remaining_ms <= 0) {
+            plan.n_limbs = 0;
+            plan.degradations = degradation::kPARTIAL;
+            return plan;
+        }
+
+        // The first image measures the cost.
+        const auto fits = [&] {
+            return !model.calibrated() || model.predict_ms(connection_units<Topology>(peak_ids_by_channel, plan)) <= remaining_ms;
+        };
+        if (fits())
+            return plan;
+
+        size_t max_peaks = 0;
+        for (const auto& peak_ids : peak_ids_by_channel)
+            max_peaks = std::max(max_peaks, peak_ids.size());
+        if (max_peaks > MIN_BUDGET_PEAKS_PER_PART) {
+            plan.degradations |= degradation::kPEAK_CAP;
+            // The largest cap that fits. (The work grows with the cap)
+            int lo = MIN_BUDGET_PEAKS_PER_PART, hi = static_cast<int>(max_peaks) - 1;
+            while (lo < hi) {
+                plan.max_peaks_per_part = (lo + hi + 1) / 2;
+                if (fits())
+                    lo = plan.max_peaks_per_part;
+                else
+                    hi = plan.max_peaks_per_part - 1;
+            }
+            plan.max_peaks_per_part = lo;
+            if (fits())
+                return plan;
+        }
+
+        plan.n_steps = STEP_PAF / 2;
+        plan.degradations |= degradation::kFEWER_PAF_SAMPLES;
+        if (fits())
+            return plan;
+
+        if (std::any_of(Topology::limbs.begin(), Topology::limbs.end(), [](const limb_t& limb) { return limb.is_virtual; })) {
+            plan.skip_virtual = true;
+            plan.degradations |= degradation::kSKIPPED_VIRTUAL_LIMBS;
+            if (fits())
+                return plan;
+        }
+
+        // The limbs are in assembly order, so the humans keep their key points closest to the first limb.
+        plan.degradations |= degradation::kPARTIAL;
+        while (plan.n_limbs > 0 && !fits())
+            --plan.n_limbs;
+        return plan;
+    }
+
+    // Map the peaks found on a `from` sized map to a `to` sized one, where pixel `p` of the former covers the pixels
+    // [p * scale, (p + 1) * scale) of the latter.
+    // The `regions` (relative to the image size) in pixels of a `size` map.
+    static std::vector<pixel_window> to_pixel_windows(const std::vector<cv::Rect2f>& regions, const cv::Size size)
+    {
+        std::vector<pixel_window> windows;
+        for (const auto& region : regions) {
+            const pixel_window window{ std::max(0, static_cast<int>(std::floor(region.y * size.height))),
+                std::min(size.height, static_cast<int>(std::ceil((region.y + region.height) * size.height))),
+                std::max(0, static_cast<int>(std::floor(region.x * size.width))),
+                std::min(size.width, static_cast<int>(std::ceil((region.x + region.width) * size.width))) };
+            if (window.row_begin < window.row_end && window.col_begin < window.col_end)
+                windows.push_back(window);
+        }
+        return windows;
+    }
+
+    // Drop the peaks outside `windows` (which the tiles searched may exceed), and renumber the others in order.
+    static void keep_peaks_inside(std::vector<peak_info>& peaks, const std::vector<pixel_window>& windows)
+    {
+        peaks.erase(std::remove_if(peaks.begin(), peaks.end(),
+                        [&](const peak_info& peak) {
+                            return std::none_of(windows.begin(), windows.end(), [&](const pixel_window& w) {
+                                return w.row_begin <= peak.pos.y && peak.pos.y < w.row_end
+                                    && w.col_begin <= peak.pos.x && peak.pos.x < w.col_end;
+                            });
+                        }),
+            peaks.end());
+        for (size_t i = 0; i < peaks.size(); ++i)
+            peaks[i].id = i;
+    }
+
+    static void scale_peaks(std::vector<peak_info>& peaks, const cv::Size from, const cv::Size to)
+    {
+        const float scale_x = static_cast<float>(to.width) / from.width;
+        const float scale_y = static_cast<float>(to.height) / from.height;
+        for (auto& peak : peaks) {
+            peak.refined_pos.x = (peak.refined_pos.x + 0.5f) * scale_x - 0.5f;
+            peak.refined_pos.y = (peak.refined_pos.y + 0.5f) * scale_y - 0.5f;
+            peak.pos.x = std::clamp(static_cast<int>(std::lround(peak.refined_pos.x)), 0, to.width - 1);
+            peak.pos.y = std::clamp(static_cast<int>(std::lround(peak.refined_pos.y)), 0, to.height - 1);
+        }
+    }
+
+    static bool is_half(const feature_map_t& map) { return map.dtype().val == data_type::kHALF; }
+
+    template <typename T>
+    static ttl::tensor_view<T, 3> tensor_view_of(const feature_map_t& map)
+    {
+        return ttl::tensor_view<T, 3>(map.view<T>(), map.shape()[0], map.shape()[1], map.shape()[2]);
+    }
+
+    // The FP32 view of a feature map at its original resolution. An FP16 map is widened into `widened` if `needed`,
+    // otherwise it's only widened on the fly while being upsampled (std::nullopt).
+    static std::optional<ttl::tensor_view<float, 3>>
+    float_view(const feature_map_t& map, std::unique_ptr<ttl::tensor<float, 3>>& widened, const bool needed)
+    {
+        if (!is_half(map))
+            return tensor_view_of<float>(map);
+        if (!needed)
+            return std::nullopt;
+
+        if (widened == nullptr)
+            widened = std::make_unique<ttl::tensor<float, 3>>(map.shape()[0], map.shape()[1], map.shape()[2]);
+        widen(tensor_view_of<std::uint16_t>(map), ttl::ref(*widened));
+        return ttl::view(*widened);
+    }
+
+    static void upsample(const feature_map_t& map, const std::optional<ttl::tensor_view<float, 3>>& fp32,
+        const ttl::tensor_ref<float, 3>& output)
+    {
+        if (fp32)
+            resize_area(*fp32, output);
+        else
+            resize_area(tensor_view_of<std::uint16_t>(map), output);
+    }
+
+    // Class basic_paf.
+    template <typename Topology>
+    struct basic_paf<Topology>::peak_finder_impl : public peak_finder_t<float> {
     public:
         using peak_finder_t::peak_finder_t;
     };
 
-    struct paf::ttl_impl {
+    // The buffers of one thread parsing an image.
+    template <typename Topology>
+    struct basic_paf<Topology>::ttl_impl {
         std::unique_ptr<ttl::tensor<float, 3>> m_upsample_paf, m_upsample_conf;
+        std::unique_ptr<ttl::tensor<float, 3>> m_widened_paf, m_widened_conf; // FP16 maps at the original resolution.
+        std::unique_ptr<peak_finder_impl> m_peak_finder_ptr;
+        combinable<limb_scratch> m_limb_scratch;
+
+        deadline m_deadline; // Of the image being parsed, started by the caller of `process`.
+        double m_ms_per_sample = 0; // The cost model of the connection stage.
+        int m_degradations = degradation::kNONE; // Of the images parsed since the caller reset it.
+
+        // The peak finder of the `parser`'s modes, recreated if the size of the map to search changes.
+        peak_finder_impl& peak_finder(const basic_paf& parser, const cv::Size native_size)
+        {
+            // In the native resolution mode, peaks are found on the CONF map itself and then mapped to `m_resolution_size`.
+            const cv::Size peak_map_size = parser.m_native_resolution_peak_finding ? native_size : parser.m_resolution_size;
+            if (m_peak_finder_ptr == UNINITIALIZED_PTR || m_peak_finder_ptr->size() != peak_map_size) {
+                if (parser.m_native_resolution_peak_finding) {
+                    // Keep the same smoothing as on the upsampled map. (ksize = 17 and sigma = 3 at 4x)
+                    const double scale = static_cast<double>(parser.m_resolution_size.width) / native_size.width;
+                    const int radius = std::max(1, static_cast<int>(std::lround(8 / scale)));
+                    m_peak_finder_ptr = std::make_unique<peak_finder_impl>(
+                        parser.m_n_joints, Topology::n_parts, native_size.height, native_size.width, 2 * radius + 1, parser.m_smoothing, 3.0 / scale);
+                } else {
+                    m_peak_finder_ptr = std::make_unique<peak_finder_impl>(
+                        parser.m_n_joints, Topology::n_parts, parser.m_resolution_size.height, parser.m_resolution_size.width, 17, parser.m_smoothing);
+                }
+                m_peak_finder_ptr->set_subpixel_refinement(parser.m_native_resolution_peak_finding);
+            }
+            m_peak_finder_ptr->set_smoothing_method(parser.m_smoothing);
+            return *m_peak_finder_ptr;
+        }
+
+        // The upsampled maps are only allocated by the modes using them.
+        void allocate_upsampled_maps(const basic_paf& parser, const feature_map_t& conf_map, const feature_map_t& paf_map)
+        {
+            const cv::Size size = parser.m_resolution_size;
+            if (!parser.m_native_resolution_peak_finding && m_upsample_conf == UNINITIALIZED_PTR)
+                m_upsample_conf = std::make_unique<ttl::tensor<float, 3>>(conf_map.shape()[0], size.height, size.width); // conf
+            if (!parser.m_native_resolution_paf_sampling && m_upsample_paf == UNINITIALIZED_PTR)
+                m_upsample_paf = std::make_unique<ttl::tensor<float, 3>>(paf_map.shape()[0], size.height, size.width); // paf
+        }
+
+        // Select the tiles of the peak map to search: near the values above `conf_thresh`(sparse mode), or in
+        // `regions_by_part`(video mode), and within the regions of interest(`roi`, in peak map pixels). Returns false if
+        // no tile can hold a peak, except in the video mode, which parses the frame fully if it finds no peak.
+        bool select_tiles(const basic_paf& parser, peak_finder_impl& finder, const std::optional<ttl::tensor_view<float, 3>>& conf,
+            const float conf_thresh, const std::vector<pixel_window>& roi,
+            const std::vector<std::vector<pixel_window>>* regions_by_part = nullptr)
+        {
+            const bool masked = !parser.m_regions_of_interest.empty();
+            if (regions_by_part != nullptr)
+                finder.find_candidate_tiles_around(*regions_by_part);
+            else if (parser.m_sparse_peak_finding) {
+                if (!finder.find_candidate_tiles(*conf, conf_thresh))
+                    return false;
+            } else if (masked)
+                finder.find_candidate_tiles_around(std::vector<std::vector<pixel_window>>(Topology::n_parts, roi));
+
+            const bool any = !masked || finder.clip_candidate_tiles(roi);
+            return any || regions_by_part != nullptr;
+        }
+
+        // Upsample the maps which the `parser`'s modes read at `m_resolution_size`. (`conf` and `paf` are the FP32 views)
+        void upsample_maps(const basic_paf& parser, const feature_map_t& conf_map, const feature_map_t& paf_map,
+            const std::optional<ttl::tensor_view<float, 3>>& conf, const std::optional<ttl::tensor_view<float, 3>>& paf)
+        {
+            allocate_upsampled_maps(parser, conf_map, paf_map);
+
+            TRACE_SCOPE("resize heatmap and PAF");
+            if (!parser.m_native_resolution_peak_finding)
+                upsample(conf_map, conf, ttl::ref(*m_upsample_conf));
+            if (!parser.m_native_resolution_paf_sampling)
+                upsample(paf_map, paf, ttl::ref(*m_upsample_paf));
+        }
+
+        // Allocate what `process` lazily allocates for maps like these, except the per-thread limb buffers.
+        void prepare(const basic_paf& parser, const feature_map_t& conf_map, const feature_map_t& paf_map)
+        {
+            float_view(conf_map, m_widened_conf, parser.m_native_resolution_peak_finding || parser.m_sparse_peak_finding);
+            float_view(paf_map, m_widened_paf, parser.m_native_resolution_paf_sampling);
+            peak_finder(parser, cv::Size(conf_map.shape()[2], conf_map.shape()[1]));
+            allocate_upsampled_maps(parser, conf_map, paf_map);
+        }
+
+        // The map to find peaks on, after `upsample_maps`.
+        ttl::tensor_view<float, 3> peak_map(const basic_paf& parser, const std::optional<ttl::tensor_view<float, 3>>& conf) const
+        {
+            return parser.m_native_resolution_peak_finding ? *conf : ttl::view(*m_upsample_conf);
+        }
+
+        // The sampler of the PAF map, after `upsample_maps`.
+        paf_sampler sampler(const basic_paf& parser, const std::optional<ttl::tensor_view<float, 3>>& paf) const
+        {
+            if (!parser.m_native_resolution_paf_sampling)
+                return paf_sampler{ ttl::view(*m_upsample_paf), false, 1, 1 };
+            const auto [channel, height, width] = paf->dims();
+            return paf_sampler{ *paf, true,
+                static_cast<float>(parser.m_resolution_size.width) / width,
+                static_cast<float>(parser.m_resolution_size.height) / height };
+        }
+    };
+
+    // `process_batch` parses the images in `hyperpose::parallel_for`, each with a `ttl_impl` of the thread running it.
+    // So the buffers grow with the number of threads instead of the batch size.
+    template <typename Topology>
+    struct basic_paf<Topology>::batch_impl {
+        worker_buffers<ttl_impl> m_buffers;
     };
 
-    paf::paf(float conf_thresh, float paf_thresh, cv::Size resolution_size)
+    // The video mode state: the humans of the last frame, which predict where to search in the current one.
+    template <typename Topology>
+    struct basic_paf<Topology>::video_impl {
+        std::vector<human_type> m_last_humans;
+        int m_frames_since_keyframe = 0;
+        std::vector<std::vector<pixel_window>> m_regions; // Where to search each part, in peak map pixels.
+    };
+
+    template <typename Topology>
+    basic_paf<Topology>::basic_paf(float conf_thresh, float paf_thresh, cv::Size resolution_size)
         : m_conf_thresh(conf_thresh)
         , m_paf_thresh(paf_thresh)
         , m_resolution_size(resolution_size)
@@ -284,26 +621,43 @@ namespace parser {
     {
     }
 
-    paf::paf(const paf& p)
+    template <typename Topology>
+    basic_paf<Topology>::basic_paf(const basic_paf& p)
         : m_conf_thresh(p.m_conf_thresh)
         , m_paf_thresh(p.m_paf_thresh)
         , m_resolution_size(p.m_resolution_size)
+        , m_smoothing(p.m_smoothing)
+        , m_sparse_peak_finding(p.m_sparse_peak_finding)
+        , m_native_resolution_peak_finding(p.m_native_resolution_peak_finding)
+        , m_native_resolution_paf_sampling(p.m_native_resolution_paf_sampling)
+        , m_max_limb_length(p.m_max_limb_length)
+        , m_max_peaks_per_part(p.m_max_peaks_per_part)
+        , m_regions_of_interest(p.m_regions_of_interest)
+        , m_time_budget(p.m_time_budget)
         , m_ttl(UNINITIALIZED_PTR)
+        , m_keyframe_interval(p.m_keyframe_interval)
+        , m_max_motion(p.m_max_motion)
+        , m_video(p.m_video == UNINITIALIZED_PTR ? UNINITIALIZED_PTR : std::make_unique<video_impl>())
     {
     }
 
-    std::vector<human_t> paf::process(const feature_map_t& conf_map, const feature_map_t& paf_map)
+    template <typename Topology>
+    void basic_paf<Topology>::check_feature_maps(const feature_map_t& conf_map, const feature_map_t& paf_map)
     {
-        TRACE_SCOPE("PAF");
-        
         if (conf_map.shape().size() != 3 || paf_map.shape().size() != 3)
             error("Input of PAF::PROCESS didn't meet requirements: [conf, paf], tensor.dims() == 3\n");
 
-        auto conf_tensor_ref = ttl::tensor_view<float, 3>(conf_map.view<float>(), conf_map.shape()[0], conf_map.shape()[1], conf_map.shape()[2]);
-        auto paf_tensor_ref = ttl::tensor_view<float, 3>(paf_map.view<float>(), paf_map.shape()[0], paf_map.shape()[1], paf_map.shape()[2]);
+        for (const feature_map_t* map : { &conf_map, &paf_map })
+            if (map->dtype().val != data_type::kFLOAT && map->dtype().val != data_type::kHALF)
+                error("Input of PAF::PROCESS didn't meet requirements: ", map->name(), " must be FP32 or FP16, got data type ", map->dtype().val, '\n');
 
-        auto [n_connections_2_, fw_paf, fh_paf] = paf_tensor_ref.dims();
-        auto [n_joints_, fw_conf, fh_conf] = conf_tensor_ref.dims();
+        const int n_connections_2_ = paf_map.shape()[0], fh_paf = paf_map.shape()[1], fw_paf = paf_map.shape()[2];
+        const int n_joints_ = conf_map.shape()[0], fh_conf = conf_map.shape()[1], fw_conf = conf_map.shape()[2];
+
+        constexpr int n_paf_channels = 2 * Topology::limbs.size();
+        if (n_joints_ < Topology::n_parts || n_connections_2_ < n_paf_channels)
+            error("Input of PAF::PROCESS didn't match the topology: [conf, paf] need at least [", Topology::n_parts, ", ",
+                n_paf_channels, "] channels, got [", n_joints_, ", ", n_connections_2_, "]\n");
 
         if (m_resolution_size.width == UNINITIALIZED_VAL || m_resolution_size.height == UNINITIALIZED_VAL)
             m_resolution_size = cv::Size(fw_paf * 4, fh_paf * 4);
@@ -317,70 +671,468 @@ namespace parser {
             m_n_joints = n_joints_;
 
             m_ttl = std::make_unique<ttl_impl>();
-            m_ttl->m_upsample_conf = std::make_unique<ttl::tensor<float, 3>>(n_joints_, m_resolution_size.height, m_resolution_size.width); // conf
-            m_ttl->m_upsample_paf = std::make_unique<ttl::tensor<float, 3>>(n_connections_2_, m_resolution_size.height, m_resolution_size.width); // paf
 
             m_feature_size = cv::Size(fw_paf, fh_paf);
-            m_peak_finder_ptr = std::make_unique<paf::peak_finder_impl>(
-                m_n_joints, m_resolution_size.height, m_resolution_size.width, 17);
+        }
+    }
+
+    template <typename Topology>
+    std::vector<typename basic_paf<Topology>::human_type> basic_paf<Topology>::process(const feature_map_t& conf_map, const feature_map_t& paf_map)
+    {
+        TRACE_SCOPE("PAF");
+
+        check_feature_maps(conf_map, paf_map);
+        m_ttl->m_degradations = degradation::kNONE;
+        m_ttl->m_deadline.start(m_time_budget);
+        auto humans = process(*m_ttl, conf_map, paf_map, m_video.get());
+        m_last_degradations = m_ttl->m_degradations;
+        return humans;
+    }
+
+    template <typename Topology>
+    std::vector<std::vector<typename basic_paf<Topology>::human_type>> basic_paf<Topology>::process_batch(std::vector<internal_t>& batch)
+    {
+        std::vector<int> degradations;
+        return process_batch(batch, degradations);
+    }
+
+    template <typename Topology>
+    std::vector<std::vector<typename basic_paf<Topology>::human_type>> basic_paf<Topology>::process_batch(
+        std::vector<internal_t>& batch, std::vector<int>& degradations)
+    {
+        TRACE_SCOPE("PAF::process_batch");
+
+        degradations.assign(batch.size(), degradation::kNONE);
+        if (batch.empty())
+            return {};
+
+        // The (lazy) initialization is not thread-safe, so it's done before going parallel.
+        for (const auto& feature_maps : batch)
+            check_feature_maps(feature_maps[0], feature_maps[1]);
+        if (m_batch == UNINITIALIZED_PTR)
+            m_batch = std::make_unique<batch_impl>();
+
+        // Each image has the whole time budget.
+        std::vector<std::vector<human_type>> pose_sets(batch.size());
+        const auto parse = [&](ttl_impl& buffers, const size_t i, video_impl* video) {
+            buffers.m_degradations = degradation::kNONE;
+            buffers.m_deadline.start(m_time_budget);
+            pose_sets[i] = process(buffers, batch[i][0], batch[i][1], video);
+            degradations[i] = buffers.m_degradations;
+        };
+
+        if (m_video != UNINITIALIZED_PTR) { // Each frame is predicted from the previous one.
+            for (size_t i = 0; i < batch.size(); ++i)
+                parse(*m_ttl, i, m_video.get());
+        } else {
+            hyperpose::parallel_for(batch.size(), [&](const size_t i) {
+                m_batch->m_buffers.with_local([&](ttl_impl& buffers) { parse(buffers, i, nullptr); });
+            });
         }
 
-        auto& m_peak_finder = *m_peak_finder_ptr;
+        m_last_degradations = degradation::kNONE;
+        for (const int flags : degradations)
+            m_last_degradations |= flags;
+        return pose_sets;
+    }
+
+    template <typename Topology>
+    std::vector<std::vector<typename basic_paf<Topology>::human_type>> basic_paf<Topology>::process_thresholds(
+        const feature_map_t& conf_map, const feature_map_t& paf_map, const std::vector<std::pair<float, float>>& thresholds)
+    {
+        TRACE_SCOPE("PAF::process_thresholds");
+
+        std::vector<std::vector<human_type>> pose_sets(thresholds.size());
+        if (thresholds.empty())
+            return pose_sets;
+
+        check_feature_maps(conf_map, paf_map);
+        auto& buffers = *m_ttl;
+
+        // The peaks and limbs found with the lowest thresholds are a superset of the ones of every pair.
+        float min_conf_thresh = thresholds[0].first, min_paf_thresh = thresholds[0].second;
+        for (const auto& [conf_thresh, paf_thresh] : thresholds) {
+            min_conf_thresh = std::min(min_conf_thresh, conf_thresh);
+            min_paf_thresh = std::min(min_paf_thresh, paf_thresh);
+        }
 
+        const auto conf_tensor_ref = float_view(conf_map, buffers.m_widened_conf, m_native_resolution_peak_finding || m_sparse_peak_finding);
+        const auto paf_tensor_ref = float_view(paf_map, buffers.m_widened_paf, m_native_resolution_paf_sampling);
+
+        // The maps are upsampled and smoothed, and the peaks found, only once.
+        const cv::Size native_size(conf_map.shape()[2], conf_map.shape()[1]);
+        auto& peak_finder = buffers.peak_finder(*this, native_size);
+        const bool masked = !m_regions_of_interest.empty();
+        const auto roi = to_pixel_windows(m_regions_of_interest, peak_finder.size());
+        if (!buffers.select_tiles(*this, peak_finder, conf_tensor_ref, min_conf_thresh, roi)) {
+            info("No peak candidates, got 0 humans\n");
+            return pose_sets;
+        }
+
+        buffers.upsample_maps(*this, conf_map, paf_map, conf_tensor_ref, paf_tensor_ref);
+
+        auto all_peaks = peak_finder.find_peak_coords(buffers.peak_map(*this, conf_tensor_ref),
+            min_conf_thresh, false /* use_gpu */, m_sparse_peak_finding || masked);
+        if (masked)
+            keep_peaks_inside(all_peaks, roi);
+        if (m_native_resolution_peak_finding)
+            scale_peaks(all_peaks, native_size, m_resolution_size);
+
+        // The peaks above the CONF threshold of each pair, numbered as if they were found with it. `connected` maps the
+        // ids of `all_peaks` to them, or to -1 for the peaks dropped by the threshold or by `m_max_peaks_per_part`.
+        struct threshold_peaks {
+            std::vector<peak_info> peaks;
+            std::vector<int> connected;
+        };
+        std::vector<threshold_peaks> peaks_of(thresholds.size());
+        hyperpose::parallel_for(thresholds.size(), [&](const size_t t)
         {
-            TRACE_SCOPE("resize heatmap and PAF");
-            resize_area(conf_tensor_ref, ttl::ref(*(m_ttl->m_upsample_conf)));
-            resize_area(paf_tensor_ref, ttl::ref(*(m_ttl->m_upsample_paf)));
+            auto& [peaks, connected] = peaks_of[t];
+            connected.assign(all_peaks.size(), -1);
+            std::vector<int> original_ids;
+            for (const auto& peak : all_peaks)
+                if (peak.level > thresholds[t].first) {
+                    original_ids.push_back(peak.id);
+                    peaks.push_back(peak);
+                    peaks.back().id = peaks.size() - 1;
+                }
+
+            auto ids_by_channel = peak_finder.group_by(peaks);
+            if (m_max_peaks_per_part > 0)
+                keep_top_k_peaks(ids_by_channel, peaks, m_max_peaks_per_part);
+            for (const auto& ids : ids_by_channel)
+                for (const int id : ids)
+                    connected[original_ids[id]] = id;
+        });
+
+        // Only the peaks connected with some pair are scored, once for all of them. Each candidate keeps the highest PAF
+        // threshold it passes, so the pairs only filter them.
+        std::vector<std::vector<int>> peak_ids_by_channel(Topology::n_parts);
+        for (const auto& peak : all_peaks)
+            if (std::any_of(peaks_of.begin(), peaks_of.end(), [&](const threshold_peaks& p) { return p.connected[peak.id] >= 0; }))
+                peak_ids_by_channel[peak.part_id].push_back(peak.id);
+
+        const paf_sampler sampler = buffers.sampler(*this, paf_tensor_ref);
+        std::vector<std::vector<connection_candidate>> all_candidates(Topology::limbs.size());
+        {
+            TRACE_SCOPE("get connection candidates");
+            const float max_limb_length = m_max_limb_length * m_resolution_size.height;
+            hyperpose::parallel_for(Topology::limbs.size(), [&](const size_t pair_id)
+            {
+                const limb_t& limb = Topology::limbs[pair_id];
+                auto& scratch = buffers.m_limb_scratch.local();
+                get_connection_candidates(scratch, sampler, all_peaks, {}, peak_ids_by_channel[limb.part1],
+                    peak_ids_by_channel[limb.part2], limb, m_feature_size.height, min_paf_thresh, max_limb_length,
+                    STEP_PAF, true);
+                all_candidates[pair_id] = scratch.candidates;
+            });
         }
 
-        // Get all peaks.
-        const auto all_peaks = m_peak_finder.find_peak_coords(
-            ttl::view(*(m_ttl->m_upsample_conf)), m_conf_thresh, false /* use_gpu */);
-        const auto peak_ids_by_channel = m_peak_finder.group_by(all_peaks);
+        TRACE_SCOPE("assemble humans of each threshold pair");
+        hyperpose::parallel_for(thresholds.size(), [&](const size_t t)
+        {
+            const auto& [peaks, connected] = peaks_of[t];
+            std::vector<std::vector<connection>> all_connections(Topology::limbs.size());
+            std::vector<connection_candidate> candidates;
+            for (size_t pair_id = 0; pair_id < Topology::limbs.size(); ++pair_id) {
+                candidates.clear();
+                for (auto candidate : all_candidates[pair_id]) {
+                    const int id1 = connected[candidate.idx1], id2 = connected[candidate.idx2];
+                    if (id1 >= 0 && id2 >= 0 && candidate.paf_bound > thresholds[t].second) {
+                        candidate.idx1 = id1;
+                        candidate.idx2 = id2;
+                        candidates.push_back(candidate);
+                    }
+                }
+                all_connections[pair_id] = select_connections(candidates);
+            }
 
-        const ttl::tensor_view<float, 3>& pafmap = ttl::view(*(m_ttl->m_upsample_paf));
+            pose_sets[t] = to_humans<Topology>(get_humans<Topology>(peaks, all_connections), peaks, m_resolution_size);
+        });
+        return pose_sets;
+    }
 
-        std::vector<std::vector<connection>> all_connections;
-        all_connections.reserve(COCO_N_PAIRS);
-        for (int pair_id = 0; pair_id < COCO_N_PAIRS; ++pair_id)
-            all_connections.push_back(get_connections(pafmap, all_peaks,
-                peak_ids_by_channel, pair_id,
-                m_feature_size.height, m_paf_thresh));
+    // A feature map of zeros.
+    static feature_map_t zero_map(std::string name, const std::vector<int>& shape, const data_type dtype)
+    {
+        const size_t n_elements = std::accumulate(shape.begin(), shape.end(), size_t(1), std::multiplies<size_t>());
+        const size_t n_bytes = n_elements * (dtype.val == data_type::kHALF ? sizeof(std::uint16_t) : sizeof(float));
+        return feature_map_t(std::move(name), std::unique_ptr<char[]>(new char[n_bytes]()), shape, dtype);
+    }
 
-        const auto human_refs = get_humans(all_peaks, all_connections);
-        info("Got ", human_refs.size(), " humans\n");
+    template <typename Topology>
+    void basic_paf<Topology>::prepare_buffers(const feature_map_t& conf_map, const feature_map_t& paf_map,
+        const size_t batch_size, const bool parse)
+    {
+        check_feature_maps(conf_map, paf_map);
+        if (batch_size > 1 && m_batch == UNINITIALIZED_PTR)
+            m_batch = std::make_unique<batch_impl>();
+
+        // The dummy image has no key point, but it's upsampled and searched like any other. It's parsed without the time
+        // budget and the video mode.
+        const auto prepare_and_parse = [&](ttl_impl& buffers) {
+            buffers.prepare(*this, conf_map, paf_map);
+            if (parse) {
+                buffers.m_deadline.start(0);
+                process(buffers, conf_map, paf_map);
+            }
+        };
 
-        std::vector<human_t> humans;
-        humans.reserve(human_refs.size());
-        for (const auto& hr : human_refs) {
-            human_t human;
-            human.score = hr.score;
-            for (int i = 0; i < COCO_N_PARTS; ++i) {
-                if (hr.parts[i].id != -1) {
-                    human.parts[i].has_value = true;
-                    const auto p = all_peaks[hr.parts[i].id];
-                    human.parts[i].score = p.score;
-                    human.parts[i].x = static_cast<float>(p.pos.x) / m_resolution_size.width;
-                    human.parts[i].y = static_cast<float>(p.pos.y) / m_resolution_size.height;
+        prepare_and_parse(*m_ttl);
+        if (batch_size > 1) // The buffers of the threads which a batch of this size runs on in `process_batch`.
+            hyperpose::parallel_for(batch_size, [&](const size_t) { m_batch->m_buffers.with_local(prepare_and_parse); });
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::prepare(const std::vector<int>& conf_shape, const std::vector<int>& paf_shape,
+        data_type dtype, size_t batch_size)
+    {
+        TRACE_SCOPE("PAF::prepare");
+        prepare_buffers(zero_map("conf", conf_shape, dtype), zero_map("paf", paf_shape, dtype), batch_size, false);
+    }
+
+    template <typename Topology>
+    double basic_paf<Topology>::warm_up(const std::vector<int>& conf_shape, const std::vector<int>& paf_shape,
+        data_type dtype, size_t batch_size)
+    {
+        TRACE_SCOPE("PAF::warm_up");
+        const auto begin = std::chrono::steady_clock::now();
+
+        const auto conf_map = zero_map("conf", conf_shape, dtype), paf_map = zero_map("paf", paf_shape, dtype);
+        prepare_buffers(conf_map, paf_map, batch_size, true);
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        info("PAF warmed up for ", batch_size, " image(s) in ", ms, " ms\n");
+        return ms;
+    }
+
+    // Only reads the parser's parameters, so it can run concurrently with different `buffers` (and no `video`).
+    template <typename Topology>
+    std::vector<typename basic_paf<Topology>::human_type> basic_paf<Topology>::process(ttl_impl& buffers, const feature_map_t& conf_map, const feature_map_t& paf_map,
+        video_impl* video)
+    {
+        // Only the modes reading a map at its original resolution need an FP32 copy of an FP16 one.
+        const auto conf_tensor_ref = float_view(conf_map, buffers.m_widened_conf, m_native_resolution_peak_finding || m_sparse_peak_finding);
+        const auto paf_tensor_ref = float_view(paf_map, buffers.m_widened_paf, m_native_resolution_paf_sampling);
+
+        const cv::Size native_size(conf_map.shape()[2], conf_map.shape()[1]);
+        const cv::Size peak_map_size = m_native_resolution_peak_finding ? native_size : m_resolution_size;
+        auto& peak_finder = buffers.peak_finder(*this, native_size);
+
+        // Video mode: between key frames, the peaks are only searched around the key points of the last frame.
+        const bool seeded = video != nullptr && !video->m_last_humans.empty()
+            && video->m_frames_since_keyframe + 1 < m_keyframe_interval;
+        const auto remember = [&](const std::vector<human_type>& humans) {
+            if (video != nullptr) {
+                video->m_last_humans = humans;
+                video->m_frames_since_keyframe = seeded ? video->m_frames_since_keyframe + 1 : 0;
+            }
+        };
+
+        if (seeded) {
+            // Around the last position of each part, or anywhere near the human if the part was missing.
+            const int radius = static_cast<int>(std::ceil(m_max_motion * peak_map_size.height));
+            auto& regions = video->m_regions;
+            regions.resize(Topology::n_parts);
+            for (auto& part_regions : regions)
+                part_regions.clear();
+            for (const auto& human : video->m_last_humans) {
+                pixel_window box{ peak_map_size.height, 0, peak_map_size.width, 0 };
+                for (const auto& part : human.parts)
+                    if (part.has_value) {
+                        const int x = static_cast<int>(std::lround(part.x * peak_map_size.width));
+                        const int y = static_cast<int>(std::lround(part.y * peak_map_size.height));
+                        box = { std::min(box.row_begin, y - radius), std::max(box.row_end, y + radius + 1),
+                            std::min(box.col_begin, x - radius), std::max(box.col_end, x + radius + 1) };
+                    }
+                for (int k = 0; k < Topology::n_parts; ++k) {
+                    const auto& part = human.parts[k];
+                    if (!part.has_value) {
+                        regions[k].push_back(box);
+                        continue;
+                    }
+                    const int x = static_cast<int>(std::lround(part.x * peak_map_size.width));
+                    const int y = static_cast<int>(std::lround(part.y * peak_map_size.height));
+                    regions[k].push_back({ y - radius, y + radius + 1, x - radius, x + radius + 1 });
                 }
             }
-            humans.push_back(human);
         }
 
+        const bool masked = !m_regions_of_interest.empty();
+        const auto roi = to_pixel_windows(m_regions_of_interest, peak_map_size);
+        if (!buffers.select_tiles(*this, peak_finder, conf_tensor_ref, m_conf_thresh, roi, seeded ? &video->m_regions : nullptr)) {
+            info("No peak candidates, got 0 humans\n");
+            remember({});
+            return {};
+        }
+
+        buffers.upsample_maps(*this, conf_map, paf_map, conf_tensor_ref, paf_tensor_ref);
+
+        // Get all peaks.
+        auto all_peaks = peak_finder.find_peak_coords(buffers.peak_map(*this, conf_tensor_ref),
+            m_conf_thresh, false /* use_gpu */, m_sparse_peak_finding || seeded || masked);
+        if (masked)
+            keep_peaks_inside(all_peaks, roi);
+        if (m_native_resolution_peak_finding)
+            scale_peaks(all_peaks, native_size, m_resolution_size);
+
+        // Tag each peak with the last human having the same part within `m_max_motion`, so that only the peaks of the
+        // same human are paired. Peaks near several last humans (e.g., in a crowd) stay untagged and pair with any peak.
+        std::vector<int> tracks;
+        if (seeded) {
+            const auto& last_humans = video->m_last_humans;
+            const float motion = m_max_motion * m_resolution_size.height;
+            std::vector<bool> found(last_humans.size() * Topology::n_parts, false);
+            tracks.assign(all_peaks.size(), -1);
+            for (const auto& peak : all_peaks) {
+                int n_near = 0;
+                for (size_t h = 0; h < last_humans.size(); ++h) {
+                    const auto& part = last_humans[h].parts[peak.part_id];
+                    if (part.has_value && std::abs(peak.refined_pos.x - part.x * m_resolution_size.width) <= motion
+                        && std::abs(peak.refined_pos.y - part.y * m_resolution_size.height) <= motion) {
+                        found[h * Topology::n_parts + peak.part_id] = true;
+                        tracks[peak.id] = h;
+                        ++n_near;
+                    }
+                }
+                if (n_near > 1)
+                    tracks[peak.id] = -1;
+            }
+
+            // Most key points are gone (e.g., a scene change): the last frame doesn't predict this one.
+            size_t n_predicted = 0;
+            for (const auto& human : last_humans)
+                for (const auto& part : human.parts)
+                    n_predicted += part.has_value;
+            if (2 * static_cast<size_t>(std::count(found.begin(), found.end(), true)) < n_predicted) {
+                info("Video mode: lost track of the last frame, parse it fully\n");
+                video->m_last_humans.clear();
+                return process(buffers, conf_map, paf_map, video);
+            }
+        }
+        auto peak_ids_by_channel = peak_finder.group_by(all_peaks);
+        if (m_max_peaks_per_part > 0)
+            keep_top_k_peaks(peak_ids_by_channel, all_peaks, m_max_peaks_per_part);
+
+        // Time budget: the connection stage grows with the number of people (quadratically in crowds).
+        cost_model connection_cost{ buffers.m_ms_per_sample };
+        connection_plan plan;
+        plan.n_limbs = Topology::limbs.size();
+        if (buffers.m_deadline.enabled()) {
+            plan = plan_connections<Topology>(peak_ids_by_channel, connection_cost, buffers.m_deadline.remaining_ms());
+            if (plan.max_peaks_per_part > 0)
+                keep_top_k_peaks(peak_ids_by_channel, all_peaks, plan.max_peaks_per_part);
+            if (plan.degradations != degradation::kNONE)
+                info("Time budget: degraded the connections(", plan.degradations, "), ", plan.n_limbs, '/', Topology::limbs.size(), " limb types\n");
+            buffers.m_degradations |= plan.degradations;
+        }
+
+        const paf_sampler sampler = buffers.sampler(*this, paf_tensor_ref);
+
+        // Limb types only read the peaks and the PAF map, and each one fills its own slot. So they run in parallel and
+        // the connections are in the same order as a sequential run.
+        std::vector<std::vector<connection>> all_connections(Topology::limbs.size());
+        {
+            TRACE_SCOPE("get connections");
+            const double begin_ms = buffers.m_deadline.enabled() ? buffers.m_deadline.elapsed_ms() : 0;
+            const float max_limb_length = m_max_limb_length * m_resolution_size.height;
+            hyperpose::parallel_for(plan.n_limbs, [&](const size_t pair_id)
+            {
+                if (plan.skip_virtual && Topology::limbs[pair_id].is_virtual)
+                    return;
+                all_connections[pair_id] = get_connections(buffers.m_limb_scratch.local(), sampler, all_peaks, tracks,
+                    peak_ids_by_channel, Topology::limbs[pair_id],
+                    m_feature_size.height, m_paf_thresh, max_limb_length, plan.n_steps);
+            });
+            if (buffers.m_deadline.enabled())
+                connection_cost.update(connection_units<Topology>(peak_ids_by_channel, plan), buffers.m_deadline.elapsed_ms() - begin_ms);
+        }
+
+        const auto humans = to_humans<Topology>(get_humans<Topology>(all_peaks, all_connections), all_peaks, m_resolution_size);
+        remember(humans);
         return humans;
     }
 
-    void paf::set_paf_thresh(float thresh)
+    template <typename Topology>
+    void basic_paf<Topology>::set_paf_thresh(float thresh)
     {
         m_paf_thresh = thresh;
     }
 
-    void paf::set_conf_thresh(float thresh)
+    template <typename Topology>
+    void basic_paf<Topology>::set_conf_thresh(float thresh)
     {
         m_conf_thresh = thresh;
     }
 
-    paf::~paf() = default;
+    template <typename Topology>
+    void basic_paf<Topology>::set_smoothing_method(smoothing_method method)
+    {
+        m_smoothing = method;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_sparse_peak_finding(bool sparse)
+    {
+        m_sparse_peak_finding = sparse;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_native_resolution_peak_finding(bool native)
+    {
+        m_native_resolution_peak_finding = native;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_native_resolution_paf_sampling(bool native)
+    {
+        m_native_resolution_paf_sampling = native;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_max_limb_length(float ratio)
+    {
+        m_max_limb_length = ratio;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_max_peaks_per_part(int k)
+    {
+        m_max_peaks_per_part = k;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_regions_of_interest(std::vector<cv::Rect2f> regions)
+    {
+        m_regions_of_interest = std::move(regions);
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_video_mode(int keyframe_interval, float max_motion)
+    {
+        m_keyframe_interval = keyframe_interval;
+        m_max_motion = max_motion;
+        m_video = keyframe_interval > 1 ? std::make_unique<video_impl>() : UNINITIALIZED_PTR;
+    }
+
+    template <typename Topology>
+    void basic_paf<Topology>::set_time_budget(double milliseconds)
+    {
+        m_time_budget = milliseconds;
+    }
+
+    template <typename Topology>
+    int basic_paf<Topology>::last_degradations() const
+    {
+        return m_last_degradations;
+    }
+
+    template <typename Topology>
+    basic_paf<Topology>::~basic_paf() = default;
+
+    template class basic_paf<coco_topology>;
+    template class basic_paf<body25_topology>;
+    template class basic_paf<hand21_topology>;
 
 } // namespace parser
 
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "gaussian_blur.hpp"
+#include "max_pool.hpp"
+
+namespace hyperpose {
+
+// A rectangle of pixels: rows [row_begin, row_end) x columns [col_begin, col_end).
+struct pixel_window {
+    int row_begin, row_end;
+    int col_begin, col_end;
+};
+
+// The bounding box of `windows` grown by `margin` pixels on each side, within the `height` x `width` image.
+inline pixel_window bounding_window(const std::vector<pixel_window>& windows, const int margin, const int height,
+    const int width)
+{
+    pixel_window box{ height, 0, width, 0 }; // Empty.
+    for (const auto& window : windows)
+        box = { std::min(box.row_begin, window.row_begin - margin), std::max(box.row_end, window.row_end + margin),
+            std::min(box.col_begin, window.col_begin - margin), std::max(box.col_end, window.col_end + margin) };
+    return { std::max(box.row_begin, 0), std::min(box.row_end, height), std::max(box.col_begin, 0), std::min(box.col_end, width) };
+}
+
+// Offset of the vertex of the parabola through (-1, a), (0, b), (1, c), clamped to [-0.5, 0.5].
+inline float quadratic_peak_offset(const float a, const float b, const float c)
+{
+    const float curvature = a - 2 * b + c;
+    if (curvature >= 0)
+        return 0;
+    return std::clamp(0.5f * (a - c) / curvature, -0.5f, 0.5f);
+}
+
+// Fused smooth -> 3x3 max pool -> threshold pass over one heatmap channel.
+// The image is streamed row by row: a smoothed row is produced right before it's needed and only the 3 rows the
+// pooling window covers are kept, so neither the smoothed nor the pooled image is ever materialized.
+// A peak is a pixel whose smoothed value is above the threshold and equal to the max of its 3x3 neighbourhood.
+// Peaks are reported in row-major order through `on_peak(y, x)`, or `on_peak(y, x, dy, dx)` where (dy, dx) is the
+// sub-pixel offset of the peak, from a quadratic fit of the smoothed values along each axis, or
+// `on_peak(y, x, dy, dx, value)` with the smoothed value of the peak as well.
+class fused_peak_extractor {
+public:
+    // Smooth `image` with the separable Gaussian `kernel` on the fly.
+    template <typename OnPeak>
+    void extract(const int height, const int width, const float* image, const std::vector<float>& kernel,
+        const float threshold, OnPeak&& on_peak)
+    {
+        extract(height, width, image, kernel, threshold, pixel_window{ 0, height, 0, width }, on_peak);
+    }
+
+    // Only report the peaks inside `window`. The result is the same as filtering the peaks of the whole image.
+    template <typename OnPeak>
+    void extract(const int height, const int width, const float* image, const std::vector<float>& kernel,
+        const float threshold, const pixel_window& window, OnPeak&& on_peak)
+    {
+        // The pooling window of the border pixels reaches one more column on both sides.
+        const int col_begin = std::max(window.col_begin - 1, 0), col_end = std::min(window.col_end + 1, width);
+        const int cols = col_end - col_begin;
+
+        m_cache.reset(image, height, width, kernel, col_begin, col_end);
+        m_smoothed.resize(3 * static_cast<size_t>(cols));
+        m_smoothed_rows = { -1, -1, -1 };
+
+        const auto smoothed_row = [&](const int y) -> const float* {
+            const int slot = y % 3;
+            float* row = m_smoothed.data() + static_cast<size_t>(slot) * cols;
+            if (m_smoothed_rows[slot] != y) {
+                symmetric_column_filter(m_cache.taps(y), row, cols, kernel.data(), m_cache.radius());
+                m_smoothed_rows[slot] = y;
+            }
+            return row;
+        };
+        scan(height, window, col_begin, col_end, smoothed_row, threshold, on_peak);
+    }
+
+    // `smoothed` is an already smoothed image (e.g. by the recursive Gaussian).
+    template <typename OnPeak>
+    void extract_smoothed(const int height, const int width, const float* smoothed, const float threshold,
+        OnPeak&& on_peak)
+    {
+        const pixel_window image{ 0, height, 0, width };
+        extract_smoothed(height, width, smoothed, image, threshold, image, on_peak);
+    }
+
+    // Only report the peaks inside `window`. `smoothed` only holds the `region` of the smoothed image, which must cover
+    // `window` and the pixels around it (within the image).
+    template <typename OnPeak>
+    void extract_smoothed(const int height, const int width, const float* smoothed, const pixel_window& region,
+        const float threshold, const pixel_window& window, OnPeak&& on_peak)
+    {
+        const int col_begin = std::max(window.col_begin - 1, 0), col_end = std::min(window.col_end + 1, width);
+        const int stride = region.col_end - region.col_begin;
+        const auto smoothed_row = [=](const int y) {
+            return smoothed + static_cast<size_t>(y - region.row_begin) * stride + (col_begin - region.col_begin);
+        };
+        scan(height, window, col_begin, col_end, smoothed_row, threshold, on_peak);
+    }
+
+private:
+    // `smoothed_row(y)` returns columns [col_begin, col_end) of row `y`, and must stay valid while rows `y - 1` and
+    // `y + 1` are requested.
+    template <typename SmoothedRow, typename OnPeak>
+    void scan(const int height, const pixel_window& window, const int col_begin, const int col_end,
+        SmoothedRow&& smoothed_row, const float threshold, OnPeak&& on_peak)
+    {
+        const int cols = col_end - col_begin;
+        m_column_max.resize(cols);
+        m_pooled.resize(cols);
+
+        for (int y = window.row_begin; y < window.row_end; ++y) {
+            const float* above = smoothed_row(std::max(y - 1, 0));
+            const float* row = smoothed_row(y);
+            const float* below = smoothed_row(std::min(y + 1, height - 1));
+
+            max3_rows(above, row, below, m_column_max.data(), cols);
+            max3_neighbours(m_column_max.data(), m_pooled.data(), cols);
+
+            for (int x = window.col_begin; x < window.col_end; ++x) {
+                const int i = x - col_begin;
+                if (!(row[i] > threshold && row[i] == m_pooled[i]))
+                    continue;
+
+                constexpr bool with_value = std::is_invocable_v<OnPeak&, int, int, float, float, float>;
+                if constexpr (with_value || std::is_invocable_v<OnPeak&, int, int, float, float>) {
+                    // Peaks on the image border are not refined along that axis.
+                    const float dy = y > 0 && y + 1 < height ? quadratic_peak_offset(above[i], row[i], below[i]) : 0;
+                    const float dx = i > 0 && i + 1 < cols ? quadratic_peak_offset(row[i - 1], row[i], row[i + 1]) : 0;
+                    if constexpr (with_value)
+                        on_peak(y, x, dy, dx, row[i]);
+                    else
+                        on_peak(y, x, dy, dx);
+                } else {
+                    on_peak(y, x);
+                }
+            }
+        }
+    }
+
+    gaussian_row_cache m_cache;
+    std::vector<float> m_smoothed; // 3 smoothed rows, row `y` lives in slot `y % 3`.
+    std::array<int, 3> m_smoothed_rows = { -1, -1, -1 };
+    std::vector<float> m_column_max, m_pooled;
+};
+
+// Sparse peak finding: the parts of a resized and smoothed heatmap that may hold a peak above a threshold, found
+// from the heatmap before resizing.
+// A resized pixel is a convex combination of source pixels at most one source pixel away, and a smoothed pixel is a
+// convex combination of the pixels within the kernel radius. So a region whose source pixels (plus that margin) are
+// all below the threshold can't hold a peak and is skipped.
+class candidate_tiles {
+public:
+    static constexpr int min_tile_size = 8; // In source pixels.
+
+    // Returns whether any tile of the `src_height` x `src_width` image `src` is a candidate. `height`, `width` is the
+    // resized resolution and `radius` the smoothing radius in resized pixels.
+    bool find(const float* src, const int src_height, const int src_width, const int height, const int width,
+        const int radius, const float threshold)
+    {
+        // One source pixel for the interpolation and one for rounding the tile borders to resized pixels.
+        const int margin = 2 + std::max(ceil_div(radius * src_height, height), ceil_div(radius * src_width, width));
+        // A tile is at least as large as the margin, so only its 8 neighbours have to be checked.
+        const int tile = std::max(min_tile_size, margin);
+        const int tiles_y = ceil_div(src_height, tile), tiles_x = ceil_div(src_width, tile);
+
+        m_tile_max.assign(static_cast<size_t>(tiles_y) * tiles_x, std::numeric_limits<float>::lowest());
+        for (int y = 0; y < src_height; ++y) {
+            const float* row = src + static_cast<size_t>(y) * src_width;
+            float* tile_max = m_tile_max.data() + static_cast<size_t>(y / tile) * tiles_x;
+            for (int tx = 0; tx < tiles_x; ++tx) {
+                const float* begin = row + tx * tile;
+                const float* end = row + std::min((tx + 1) * tile, src_width);
+                tile_max[tx] = std::max(tile_max[tx], *std::max_element(begin, end));
+            }
+        }
+
+        // Summing the weights in float may overshoot the max by a few ulps, leave some slack.
+        const float bound = threshold - 1e-5f * std::abs(threshold);
+        const auto is_candidate = [&](const int ty, const int tx) {
+            for (int y = std::max(ty - 1, 0); y <= std::min(ty + 1, tiles_y - 1); ++y)
+                for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, tiles_x - 1); ++x)
+                    if (m_tile_max[static_cast<size_t>(y) * tiles_x + x] > bound)
+                        return true;
+            return false;
+        };
+
+        // One window per band of tiles, spanning from its first to its last candidate tile.
+        m_windows.clear();
+        for (int ty = 0; ty < tiles_y; ++ty) {
+            int first = tiles_x, last = -1;
+            for (int tx = 0; tx < tiles_x; ++tx)
+                if (is_candidate(ty, tx)) {
+                    first = std::min(first, tx);
+                    last = tx;
+                }
+            if (last < 0)
+                continue;
+
+            const auto scale = [](const int p, const int from, const int to) {
+                return static_cast<int>(static_cast<int64_t>(std::min(p, from)) * to / from);
+            };
+            const pixel_window window{ scale(ty * tile, src_height, height), scale((ty + 1) * tile, src_height, height),
+                scale(first * tile, src_width, width), scale((last + 1) * tile, src_width, width) };
+            if (window.row_begin < window.row_end && window.col_begin < window.col_end)
+                m_windows.push_back(window);
+        }
+        return !m_windows.empty();
+    }
+
+    // Returns whether any tile of the `height` x `width` image overlaps `regions`, e.g., the neighbourhoods of the key
+    // points predicted from the previous video frame. (Tiles of `min_tile_size` pixels)
+    bool around(const std::vector<pixel_window>& regions, const int height, const int width)
+    {
+        const int tile = min_tile_size;
+        const int tiles_y = ceil_div(height, tile), tiles_x = ceil_div(width, tile);
+
+        m_near.assign(static_cast<size_t>(tiles_y) * tiles_x, 0);
+        for (const auto& region : regions) {
+            const int row_begin = std::max(region.row_begin, 0), row_end = std::min(region.row_end, height);
+            const int col_begin = std::max(region.col_begin, 0), col_end = std::min(region.col_end, width);
+            if (row_begin >= row_end || col_begin >= col_end)
+                continue;
+            for (int ty = row_begin / tile; ty <= (row_end - 1) / tile; ++ty)
+                std::fill(m_near.begin() + static_cast<size_t>(ty) * tiles_x + col_begin / tile,
+                    m_near.begin() + static_cast<size_t>(ty) * tiles_x + (col_end - 1) / tile + 1, 1);
+        }
+
+        // One window per band of tiles, as in `find`.
+        m_windows.clear();
+        for (int ty = 0; ty < tiles_y; ++ty) {
+            const auto band = m_near.begin() + static_cast<size_t>(ty) * tiles_x;
+            const auto first = std::find(band, band + tiles_x, 1);
+            if (first == band + tiles_x)
+                continue;
+            const auto last = std::find(std::make_reverse_iterator(band + tiles_x), std::make_reverse_iterator(first), 1);
+            const int col_begin = static_cast<int>(first - band) * tile;
+            const int col_end = std::min(static_cast<int>(last.base() - band) * tile, width);
+            m_windows.push_back(pixel_window{ ty * tile, std::min((ty + 1) * tile, height), col_begin, col_end });
+        }
+        return !m_windows.empty();
+    }
+
+    // Shrink each window to the extent of the `regions` overlapping it, e.g., the regions of interest. The windows stay
+    // disjoint and in row-major order. Returns whether any window is left.
+    bool clip(const std::vector<pixel_window>& regions)
+    {
+        size_t n_kept = 0;
+        for (const auto& window : m_windows) {
+            pixel_window extent{ window.row_end, window.row_begin, window.col_end, window.col_begin }; // Empty.
+            for (const auto& region : regions) {
+                const int row_begin = std::max(window.row_begin, region.row_begin), row_end = std::min(window.row_end, region.row_end);
+                const int col_begin = std::max(window.col_begin, region.col_begin), col_end = std::min(window.col_end, region.col_end);
+                if (row_begin >= row_end || col_begin >= col_end)
+                    continue;
+                extent = { std::min(extent.row_begin, row_begin), std::max(extent.row_end, row_end),
+                    std::min(extent.col_begin, col_begin), std::max(extent.col_end, col_end) };
+            }
+            if (extent.row_begin < extent.row_end)
+                m_windows[n_kept++] = extent;
+        }
+        m_windows.resize(n_kept);
+        return n_kept > 0;
+    }
+
+    // Windows of the resized image covering all candidate tiles, in row-major order.
+    const std::vector<pixel_window>& windows() const { return m_windows; }
+
+private:
+    static int ceil_div(const int a, const int b) { return (a + b - 1) / b; }
+
+    std::vector<float> m_tile_max;
+    std::vector<std::uint8_t> m_near; // Whether each tile is near a point, for `around`.
+    std::vector<pixel_window> m_windows;
+};
+
+} // namespace hyperpose
@@ -1,9 +1,16 @@
 #include "logging.hpp"
 #include <deque>
+#include <limits>
 #include <hyperpose/operator/parser/proposal_network.hpp>
+#include <hyperpose/utility/parallel_for.hpp>
 
 #include "coco.hpp"
 #include "color.hpp"
+#include "merge_table.hpp"
+#include "nms.hpp"
+#include "simd.hpp"
+#include "time_budget.hpp"
+#include "worker_buffers.hpp"
 
 namespace hyperpose {
 
@@ -40,14 +47,53 @@ namespace parser {
         { 15, 17 }, // 18
     }; // See https://www.cnblogs.com/caffeaoto/p/7793994.html.
 
+    struct limb_candidate {
+        int from, to;
+        float conf;
+    };
+
+    // The buffers reused across images, and the state kept across them. The key point types and the limb types are
+    // processed in parallel, so each of them has its own buffers.
+    struct pose_proposal::workspace {
+        double ms_per_candidate = 0; // The cost model of connecting the key points.
+        int degradations = degradation::kNONE; // Of the last image.
+
+        std::vector<nms_boxes> nms; // Per key point type.
+        std::vector<std::vector<float>> from_edge_conf; // Per limb type: n_from x n_neighbors.
+        std::vector<std::vector<limb_candidate>> limbs; // Per limb type.
+        merge_table merge;
+    };
+
+    // `process_batch` parses the images in `hyperpose::parallel_for`, each with a workspace of the thread running it.
+    // So the workspaces grow with the number of threads instead of the batch size.
+    struct pose_proposal::batch_workspaces {
+        worker_buffers<workspace> m_buffers;
+    };
+
     pose_proposal::pose_proposal(cv::Size net_resolution, float point_thresh, float limb_thresh, float mns_thresh)
         : m_net_resolution(std::move(net_resolution))
         , m_point_thresh(point_thresh)
         , m_limb_thresh(limb_thresh)
         , m_nms_thresh(mns_thresh)
+        , m_workspace(std::make_unique<workspace>())
+        , m_batch_workspaces(std::make_unique<batch_workspaces>())
     {
     }
 
+    pose_proposal::pose_proposal(const pose_proposal& p)
+        : m_net_resolution(p.m_net_resolution)
+        , m_point_thresh(p.m_point_thresh)
+        , m_limb_thresh(p.m_limb_thresh)
+        , m_nms_thresh(p.m_nms_thresh)
+        , m_regions_of_interest(p.m_regions_of_interest)
+        , m_time_budget(p.m_time_budget)
+        , m_workspace(std::make_unique<workspace>())
+        , m_batch_workspaces(std::make_unique<batch_workspaces>())
+    {
+    }
+
+    pose_proposal::~pose_proposal() = default;
+
     void pose_proposal::set_point_thresh(float thresh)
     {
         m_point_thresh = thresh;
@@ -63,13 +109,75 @@ namespace parser {
         m_nms_thresh = thresh;
     }
 
+    void pose_proposal::set_regions_of_interest(std::vector<cv::Rect2f> regions)
+    {
+        m_regions_of_interest = std::move(regions);
+    }
+
+    void pose_proposal::set_time_budget(double milliseconds)
+    {
+        m_time_budget = milliseconds;
+    }
+
+    int pose_proposal::last_degradations() const
+    {
+        return m_last_degradations;
+    }
+
     constexpr int MIN_REQUIRED_POINTS_FOR_A_MAN = 3; // 3 Connection to be a man;
+    constexpr size_t MIN_BUDGET_POINTS_PER_PART = 8; // The time budget never caps the key points of a part below this.
+
+    // Element `i` of an FP32 or FP16 feature map.
+    static float value_at(const feature_map_t& map, const size_t i)
+    {
+        if (map.dtype().val == data_type::kHALF)
+            return simd::to_float(map.view<std::uint16_t>()[i]);
+        return map.view<float>()[i];
+    }
 
     std::vector<human_t> pose_proposal::process(
         const feature_map_t& conf_point, const feature_map_t& conf_iou,
         const feature_map_t& x, const feature_map_t& y, const feature_map_t& w, const feature_map_t& h,
         const feature_map_t& edge)
     {
+        auto humans = process(*m_workspace, conf_point, conf_iou, x, y, w, h, edge);
+        m_last_degradations = m_workspace->degradations;
+        return humans;
+    }
+
+    std::vector<std::vector<human_t>> pose_proposal::process_batch(std::vector<internal_t>& batch)
+    {
+        std::vector<int> degradations;
+        return process_batch(batch, degradations);
+    }
+
+    std::vector<std::vector<human_t>> pose_proposal::process_batch(std::vector<internal_t>& batch, std::vector<int>& degradations)
+    {
+        std::vector<std::vector<human_t>> pose_sets(batch.size());
+        degradations.assign(batch.size(), degradation::kNONE);
+        hyperpose::parallel_for(batch.size(), [&](const size_t i) {
+            const auto& maps = batch[i];
+            assert(maps.size() == 7);
+            m_batch_workspaces->m_buffers.with_local([&](workspace& ws) {
+                pose_sets[i] = process(ws, maps[0], maps[1], maps[2], maps[3], maps[4], maps[5], maps[6]);
+                degradations[i] = ws.degradations;
+            });
+        });
+
+        m_last_degradations = degradation::kNONE;
+        for (const int flags : degradations)
+            m_last_degradations |= flags;
+        return pose_sets;
+    }
+
+    std::vector<human_t> pose_proposal::process(workspace& ws,
+        const feature_map_t& conf_point, const feature_map_t& conf_iou,
+        const feature_map_t& x, const feature_map_t& y, const feature_map_t& w, const feature_map_t& h,
+        const feature_map_t& edge)
+    {
+        deadline budget;
+        budget.start(m_time_budget);
+        ws.degradations = degradation::kNONE;
 
         // Current Implementation Just Ignores conf_iou according to https://github.com/wangziren1/pytorch_pose_proposal_networks.
 
@@ -107,29 +215,22 @@ namespace parser {
         using bbox = cv::Rect;
         using key_point_bboxes = std::vector<std::pair<meta_info, bbox>>;
 
-        auto nms = [this](key_point_bboxes boxes) {
-            key_point_bboxes ret;
-
+        // Sorts the boxes by confidence once and keeps the ones that survive NMS in place.
+        auto nms = [this](key_point_bboxes& boxes, nms_boxes& soa) {
             std::sort(boxes.begin(), boxes.end(), [](const std::pair<meta_info, bbox>& l, const std::pair<meta_info, bbox>& r) {
-                return l.first.conf < r.first.conf;
+                return l.first.conf > r.first.conf;
             });
 
-            const auto iou = [](const auto& l, const auto& r) {
-                float int_area = (l.second & r.second).area();
-                float union_area = l.second.area() + r.second.area() - int_area;
-                float overlap = int_area / union_area;
-                return overlap;
-            };
-
-            while (!boxes.empty()) {
-                ret.emplace_back(boxes.back());
-                boxes.pop_back();
-                for (size_t i = 0; i < boxes.size(); i++)
-                    if (iou(ret.back(), boxes[i]) >= m_nms_thresh)
-                        boxes.erase(boxes.begin() + i);
-            }
+            soa.assign(boxes.size());
+            for (size_t i = 0; i < boxes.size(); ++i)
+                soa.set(i, boxes[i].second);
+            soa.suppress(boxes.size(), m_nms_thresh);
 
-            return ret;
+            size_t n_kept = 0;
+            for (size_t i = 0; i < boxes.size(); ++i)
+                if (soa.suppressed[i] == 0.f)
+                    boxes[n_kept++] = boxes[i];
+            boxes.erase(boxes.begin() + n_kept, boxes.end());
         };
 
         struct human_point {
@@ -138,92 +239,162 @@ namespace parser {
             int human_index = -1;
         };
 
-        std::vector<key_point_bboxes> key_points;
-        key_points.reserve(n_key_points);
+        // The grid cells to search: all of them, or the ones whose centers are in the regions of interest.
+        std::vector<size_t> grids;
+        grids.reserve(n_grids);
+        for (size_t j = 0; j < n_grids; ++j) {
+            const float center_x = (j % w_grid + 0.5f) / w_grid, center_y = (j / w_grid + 0.5f) / h_grid;
+            if (m_regions_of_interest.empty()
+                || std::any_of(m_regions_of_interest.begin(), m_regions_of_interest.end(), [&](const cv::Rect2f& r) {
+                       return r.x <= center_x && center_x < r.x + r.width && r.y <= center_y && center_y < r.y + r.height;
+                   }))
+                grids.push_back(j);
+        }
 
-        for (size_t i = 0; i < n_key_points; ++i) {
-            key_point_bboxes kp_list;
+        ws.nms.resize(n_key_points);
+
+        // The key point types are independent.
+        std::vector<key_point_bboxes> key_points(n_key_points);
+        hyperpose::parallel_for(n_key_points, [&](const size_t i) {
+            auto& kp_list = key_points[i];
 
             // Collect key point bounding boxes in one type.
-            for (size_t j = 0; j < n_grids; ++j) {
+            for (const size_t j : grids) {
                 const size_t feature_map_index = n_grids * i + j;
 
-                if (m_point_thresh < conf_point.view<float>()[feature_map_index])
+                if (m_point_thresh < value_at(conf_point, feature_map_index))
                     kp_list.emplace_back(
-                        meta_info{ (int)j, conf_point.view<float>()[feature_map_index] },
-                        cv::Rect(std::max(std::min(m_net_resolution.width, static_cast<int>(x.view<float>()[feature_map_index] - w.view<float>()[feature_map_index] / 2)), 0),
-                            std::max(std::min(m_net_resolution.height, static_cast<int>(y.view<float>()[feature_map_index] - h.view<float>()[feature_map_index] / 2)), 0),
-                            std::max(std::min(m_net_resolution.width, static_cast<int>(w.view<float>()[feature_map_index])), 0),
-                            std::max(std::min(m_net_resolution.height, static_cast<int>(h.view<float>()[feature_map_index])), 0)));
+                        meta_info{ (int)j, value_at(conf_point, feature_map_index) },
+                        cv::Rect(std::max(std::min(m_net_resolution.width, static_cast<int>(value_at(x, feature_map_index) - value_at(w, feature_map_index) / 2)), 0),
+                            std::max(std::min(m_net_resolution.height, static_cast<int>(value_at(y, feature_map_index) - value_at(h, feature_map_index) / 2)), 0),
+                            std::max(std::min(m_net_resolution.width, static_cast<int>(value_at(w, feature_map_index))), 0),
+                            std::max(std::min(m_net_resolution.height, static_cast<int>(value_at(h, feature_map_index))), 0)));
             }
 
-            auto nms_kp_list = nms(std::move(kp_list));
+            nms(kp_list, ws.nms[i]);
+        });
 
-            info("Key Point @ ", i, " got ", nms_kp_list.size(), " bounding boxes after thresh + NMS.\n");
-
-            key_points.push_back(std::move(nms_kp_list));
-        }
+        for (size_t i = 0; i < n_key_points; ++i)
+            info("Key Point @ ", i, " got ", key_points[i].size(), " bounding boxes after thresh + NMS.\n");
 
         std::vector<human_t> ret_poses;
 
         size_t n_range = std::min(n_edges, COCOPAIR_STD.size());
         const size_t n_neighbors = h_edge_neighbor * w_edge_neighbor;
 
-        for (size_t i = 0; i < n_range; ++i) {
-            auto& from = key_points.at(COCOPAIR_STD[i].first);
-            auto& to = key_points.at(COCOPAIR_STD[i].second);
-
-            struct limb {
-                int from, to;
-                float conf;
+        // Time budget: the limbs are scored by reading the edge map around each `from` point and matching `to` points,
+        // and the humans they make are merged afterwards. Both are predicted from the number of candidate limbs.
+        cost_model limb_cost{ ws.ms_per_candidate };
+        const auto limb_units = [&](const size_t i, const size_t max_points) {
+            const double n_from = std::min(key_points.at(COCOPAIR_STD[i].first).size(), max_points);
+            const double n_to = std::min(key_points.at(COCOPAIR_STD[i].second).size(), max_points);
+            return n_from * (n_neighbors + n_to);
+        };
+        if (budget.enabled() && limb_cost.calibrated()) {
+            const auto fits = [&](const size_t max_points) {
+                double units = 0;
+                for (size_t i = 0; i < n_range; ++i)
+                    units += limb_units(i, max_points);
+                return limb_cost.predict_ms(units) <= budget.remaining_ms();
             };
 
-            std::vector<limb> limb_candidates{};
+            size_t max_points = 0;
+            for (const auto& points : key_points)
+                max_points = std::max(max_points, points.size());
+            if (max_points > MIN_BUDGET_POINTS_PER_PART && !fits(max_points)) {
+                // The largest cap that fits. (`key_points` are sorted by confidence after NMS)
+                size_t lo = MIN_BUDGET_POINTS_PER_PART, hi = max_points - 1;
+                while (lo < hi) {
+                    const size_t mid = (lo + hi + 1) / 2;
+                    if (fits(mid))
+                        lo = mid;
+                    else
+                        hi = mid - 1;
+                }
+                for (auto& points : key_points)
+                    if (points.size() > lo)
+                        points.erase(points.begin() + lo, points.end());
+                ws.degradations |= degradation::kPEAK_CAP;
+                info("Time budget: kept ", lo, " key points per part\n");
+            }
+        }
+
+        // The index of the key point of each type in each grid cell (-1 for none), so that the `to` point of a limb is
+        // looked up in O(1). (A grid cell holds at most one key point of a type)
+        std::vector<int> point_at_grid(n_key_points * n_grids, -1);
+        for (size_t k = 0; k < n_key_points; ++k)
+            for (size_t p = 0; p < key_points[k].size(); ++p)
+                point_at_grid[k * n_grids + key_points[k][p].first.grid_index] = p;
 
-            // 17 x 9 x 9 x 12 x 12
+        const double limbs_begin_ms = budget.enabled() ? budget.elapsed_ms() : 0;
+        double limbs_units = 0;
+        size_t n_limbs = n_range;
+        for (size_t i = 0; i < n_range; ++i) {
+            // The limb types are connected in order, so the humans found so far keep the key points of the first ones.
+            const double units = limb_units(i, std::numeric_limits<size_t>::max());
+            if (budget.enabled() && limb_cost.predict_ms(limbs_units + units) >= budget.remaining_ms()) {
+                ws.degradations |= degradation::kPARTIAL;
+                info("Time budget: connected ", i, '/', n_range, " limb types\n");
+                n_limbs = i;
+                break;
+            }
+            limbs_units += units;
+        }
+
+        // The limb candidates of each type are found and ranked in parallel, and then assembled in order.
+        ws.from_edge_conf.resize(n_range);
+        ws.limbs.resize(n_range);
+        hyperpose::parallel_for(n_limbs, [&](const size_t i) {
+            const auto& from = key_points.at(COCOPAIR_STD[i].first);
+            auto& limb_candidates = ws.limbs[i];
+            limb_candidates.clear();
+
+            // 17 x 9 x 9 x 12 x 12: Gather the edge confidences of the `from` points one neighbor row (n_grids) at a
+            // time, into a buffer where the neighbors of each `from` point are contiguous.
+            auto& from_edge_conf = ws.from_edge_conf[i];
+            from_edge_conf.resize(from.size() * n_neighbors);
+            for (size_t j = 0; j < n_neighbors; ++j) {
+                const size_t edge_row = i * (n_grids * n_neighbors) + j * n_grids;
+                for (size_t from_index = 0; from_index < from.size(); ++from_index)
+                    from_edge_conf[from_index * n_neighbors + j] = value_at(edge, edge_row + from[from_index].first.grid_index);
+            }
+
+            const int* to_at_grid = &point_at_grid[COCOPAIR_STD[i].second * n_grids];
             for (size_t from_index = 0; from_index < from.size(); ++from_index) {
-                auto& from_p = from[from_index];
-                const auto& from_grid_index = from_p.first.grid_index; // Location of start point in the feature map.
+                const size_t from_grid_index = from[from_index].first.grid_index; // Location of start point in the feature map.
+                const size_t from_grid_y = from_grid_index / w_grid;
+                const size_t from_grid_x = from_grid_index - from_grid_y * w_grid;
+                const float* edge_conf = &from_edge_conf[from_index * n_neighbors];
                 for (size_t j = 0; j < n_neighbors; ++j) {
-                    const size_t edge_conf_index = i * (n_grids * n_neighbors) + j * n_grids + from_grid_index;
-
-                    const size_t from_grid_y = from_grid_index / w_grid;
-                    const size_t from_grid_x = from_grid_index - from_grid_y * w_grid;
+                    const auto possible_connection_conf = edge_conf[j];
+                    if (!(possible_connection_conf > m_limb_thresh))
+                        continue;
 
                     const size_t aim_neighbor_y = j / w_edge_neighbor;
                     const size_t aim_neighbor_x = j - w_edge_neighbor * aim_neighbor_y;
 
+                    // Unsigned: the cells above / left of the map wrap around and are out of range as well.
                     const size_t aim_to_y = from_grid_y + aim_neighbor_y - h_edge_neighbor / 2;
                     const size_t aim_to_x = from_grid_x + aim_neighbor_x - w_edge_neighbor / 2;
+                    if (aim_to_x >= w_grid || aim_to_y >= h_grid)
+                        continue;
 
-                    bool out_of_range = (aim_to_x < 0 || aim_to_x >= w_grid || aim_to_y < 0 || aim_to_y >= h_grid);
-                    auto possible_connection_conf = edge.view<float>()[edge_conf_index];
-                    if (!out_of_range && possible_connection_conf > m_limb_thresh) {
-                        for (size_t to_index = 0; to_index < to.size(); ++to_index) {
-                            auto&& p_to = to[to_index];
-                            size_t to_grid_y = p_to.first.grid_index / w_grid;
-                            size_t to_grid_x = p_to.first.grid_index - to_grid_y * w_grid;
-                            if (to_grid_x == aim_to_x && to_grid_y == aim_to_y) { // Match Point!
-                                limb_candidates.push_back({ (int)from_index, (int)to_index, possible_connection_conf });
-                            }
-                        }
-                    }
+                    const int to_index = to_at_grid[aim_to_y * w_grid + aim_to_x];
+                    if (to_index != -1) // Match Point!
+                        limb_candidates.push_back({ (int)from_index, to_index, possible_connection_conf });
                 }
-                //            if (best_to_id != -1) {
-                //                ret_poses[from_p.first.root()].parts[COCOPAIR_STD[i].second] = {
-                //                    true,
-                //                    (float)(to[best_to_id].second.x + to[best_to_id].second.width / 2) / m_net_resolution.width,
-                //                    (float)(to[best_to_id].second.y + to[best_to_id].second.height / 2) / m_net_resolution.height,
-                //                    to[best_to_id].first.conf
-                //                };
-                //                ret_poses[from_p.first.root()].score += 1.;
-                //            }
             }
 
             // All right. We now get all possible [from, to] pairs. Let's choose them by rank.
             std::sort(limb_candidates.begin(), limb_candidates.end(), [](auto& l, auto& r) {
                 return l.conf < r.conf;
             });
+        });
+
+        for (size_t i = 0; i < n_limbs; ++i) {
+            auto& from = key_points.at(COCOPAIR_STD[i].first);
+            auto& to = key_points.at(COCOPAIR_STD[i].second);
+            auto& limb_candidates = ws.limbs[i];
 
             std::vector<bool> from_check(from.size(), false);
             std::vector<bool> to_check(to.size(), false);
@@ -272,59 +443,14 @@ namespace parser {
 
         info("Detected ", ret_poses.size(), " human parts originally\n");
 
-        constexpr size_t grid_size = 64;
-        std::array<std::array<std::vector<uint16_t>, grid_size>, grid_size> hash_table{};
-
-        const auto query_table = [grid_size, &hash_table](const body_part_t& part) -> std::vector<uint16_t>& {
-            assert(part.x >= 0);
-            assert(part.y >= 0);
-            size_t x_ind = part.x * grid_size;
-            size_t y_ind = part.y * grid_size;
-            x_ind = (x_ind == grid_size) ? grid_size - 1 : x_ind;
-            y_ind = (y_ind == grid_size) ? grid_size - 1 : y_ind;
-            return hash_table[x_ind][y_ind];
-        };
-
-        for (size_t i = 0; i < ret_poses.size(); ++i) {
-            auto& cur_human = ret_poses[i]; // We are trying to find other parts for current human.
-            if (cur_human.score > n_key_points - 0.1)
-                continue;
-
-            for (size_t j = 0; j < cur_human.parts.size(); ++j) {
-                const auto& this_part = cur_human.parts[j]; // Current part: Unique Or Belong to Others.
-                if (this_part.has_value) {
-                    auto& maybes = query_table(this_part);
-
-                    bool remove_cur = false;
-                    for (auto possible_id : maybes) {
-                        auto& maybe_combine = ret_poses[possible_id];
-                        if (possible_id == i || maybe_combine.parts[j].y != this_part.y || maybe_combine.parts[j].x != this_part.x)
-                            continue;
-
-                        remove_cur = true;
-                        for (size_t u = 0; u < cur_human.parts.size(); ++u) {
-                            const auto& cur_part = cur_human.parts[u];
-                            if (cur_part.has_value && !maybe_combine.parts[u].has_value) {
-                                maybe_combine.parts[u] = cur_part;
-                                maybe_combine.score += 1.0;
-                                query_table(cur_part).push_back(i);
-                            }
-                        }
-
-                        ret_poses.erase(ret_poses.begin() + i);
-                        --i;
-                        break;
-                    }
-
-                    if (remove_cur)
-                        break;
+        // Merge the humans sharing a key point: the merged humans are left as tombstones(score 0) and removed with the
+        // humans of too few key points below.
+        const size_t n_merged = merge_humans(ret_poses, ws.merge, n_key_points);
 
-                    maybes.push_back(i);
-                }
-            }
-        }
+        if (budget.enabled())
+            limb_cost.update(limbs_units, budget.elapsed_ms() - limbs_begin_ms);
 
-        info("Combined to ", ret_poses.size(), " human parts.\n");
+        info("Combined to ", ret_poses.size() - n_merged, " human parts.\n");
 
         ret_poses.erase(std::remove_if(ret_poses.begin(), ret_poses.end(), [](const human_t& pose) {
             return pose.score <= MIN_REQUIRED_POINTS_FOR_A_MAN;
@@ -3,7 +3,11 @@
 #include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 #include <cuda_runtime.h>
 #include <opencv2/opencv.hpp>
@@ -12,15 +16,17 @@
 #include <ttl/range>
 #include <ttl/tensor>
 
+#include <hyperpose/operator/parser/paf.hpp>
 #include <hyperpose/utility/human.hpp>
 #include <hyperpose/utility/parallel_for.hpp>
-#ifdef HYPERPOSE_PARALLELIZE_FIND_ALL_PEAKS
-    #include <hyperpose/utility/combinable.hpp>
-#endif
 
 #include "cudnn.hpp"
+#include "gaussian_blur.hpp"
 #include "logging.hpp"
+#include "max_pool.hpp"
+#include "peak_extraction.hpp"
 #include "trace.hpp"
+#include "upsample.hpp"
 
 #undef min
 #undef max
@@ -43,14 +49,21 @@ void resize_area(const ttl::tensor_view<T, 3>& input, const ttl::tensor_ref<T, 3
 
     assert(channel == target_channel);
 
+    // Upsampling by integer factors (e.g., the default 4x) replicates pixels, no need to go through OpenCV.
+    if constexpr (std::is_same_v<T, float>) {
+        if (target_height % height == 0 && target_width % width == 0) {
+            const int factor_y = target_height / height, factor_x = target_width / width;
+            hyperpose::parallel_for(channel, [=, &input, &output](const decltype(channel) k)
+            {
+                replicate_upsample_2d(height, width, input[k].data(), output[k].data(), factor_y, factor_x);
+            });
+            return;
+        }
+    }
+
     const cv::Size size(width, height);
     const cv::Size target_size(target_width, target_height);
 
-    // What if blob => Image => Resize => Blob?
-    //    cv::Mat feature_map(size, cv::DataType<T>::type, );
-    // TODO: Optimize here. (50% runtime cost in PAF as the channel size is too
-    // big(38)). Back soon when I get up.
-
     hyperpose::parallel_for(channel, [size, target_size, &input, &output](const std::size_t k)
     {
         const cv::Mat input_image(size, cv::DataType<T>::type, (T*)input[k].data());
@@ -59,47 +72,82 @@ void resize_area(const ttl::tensor_view<T, 3>& input, const ttl::tensor_ref<T, 3
     });
 }
 
+// resize_area of an FP16 (IEEE binary16 bits) map into an FP32 one. Integer factors widen the values on the fly,
+// otherwise each channel is widened before being resized by OpenCV.
+inline void resize_area(const ttl::tensor_view<std::uint16_t, 3>& input, const ttl::tensor_ref<float, 3>& output)
+{
+    TRACE_SCOPE(__func__);
+
+    const auto [channel, height, width] = input.dims();
+    const auto [target_channel, target_height, target_width] = output.dims();
+
+    assert(channel == target_channel);
+
+    if (target_height % height == 0 && target_width % width == 0) {
+        const int factor_y = target_height / height, factor_x = target_width / width;
+        hyperpose::parallel_for(channel, [=, &input, &output](const decltype(channel) k)
+        {
+            replicate_upsample_2d(height, width, input[k].data(), output[k].data(), factor_y, factor_x);
+        });
+        return;
+    }
+
+    const cv::Size size(width, height);
+    const cv::Size target_size(target_width, target_height);
+
+    hyperpose::parallel_for(channel, [size, target_size, &input, &output](const std::size_t k)
+    {
+        thread_local std::vector<float> widened;
+        widened.resize(size.area());
+        repeat_row<1>(input[k].data(), widened.data(), size.area());
+        const cv::Mat input_image(size, cv::DataType<float>::type, widened.data());
+        cv::Mat output_image(target_size, cv::DataType<float>::type, output[k].data());
+        cv::resize(input_image, output_image, output_image.size(), 0, 0, cv::INTER_AREA);
+    });
+}
+
+// FP16 (IEEE binary16 bits) -> FP32, for the kernels reading a map at its original resolution.
+inline void widen(const ttl::tensor_view<std::uint16_t, 3>& input, const ttl::tensor_ref<float, 3>& output)
+{
+    TRACE_SCOPE(__func__);
+
+    const auto [channel, height, width] = input.dims();
+    assert(input.dims() == output.dims());
+
+    hyperpose::parallel_for(channel, [=, &input, &output](const decltype(channel) k)
+    {
+        repeat_row<1>(input[k].data(), output[k].data(), height * width);
+    });
+}
+
+// Gaussian smoothing with BORDER_REFLECT_101, the same as cv::GaussianBlur.
 template <typename T>
 void smooth(const ttl::tensor_view<T, 3>& input,
-    const ttl::tensor_ref<T, 3>& output, int ksize)
+    const ttl::tensor_ref<T, 3>& output, const std::vector<float>& kernel)
 {
-    constexpr const T sigma = 3.0;
+    static_assert(std::is_same_v<T, float>, "Only float heatmaps can be smoothed.");
     const auto [channel, height, width] = input.dims();
-    const cv::Size size(width, height);
-    
-    hyperpose::parallel_for(channel, [=, &input, &output](const std::size_t k)
+
+    hyperpose::parallel_for(channel, [=, &input, &output, &kernel](const decltype(channel) k)
     {
-        const cv::Mat input_image(size, cv::DataType<T>::type,
-            (T*)input[k].data());
-        cv::Mat output_image(size, cv::DataType<T>::type, output[k].data());
-        if (ksize > 1)
-            cv::GaussianBlur(input_image, output_image, cv::Size(ksize, ksize),
-                sigma);
+        thread_local gaussian_row_cache cache;
+        separable_gaussian_blur_2d(height, width, input[k].data(), output[k].data(), kernel, cache);
     });
 }
 
+// Recursive Gaussian smoothing, whose cost does not depend on the kernel size.
 template <typename T>
-void same_max_pool_3x3_2d(const int height, const int width, //
-    const T* input, T* output)
+void smooth_recursive(const ttl::tensor_view<T, 3>& input,
+    const ttl::tensor_ref<T, 3>& output, const recursive_gaussian_coefficients& coefficients)
 {
-    constexpr const auto at = [&](int i, int j) { return i * width + j; };
-
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j < width; ++j) {
-            const int p_index = at(i, j);
-            float max_val = input[p_index];
-            for (int dx = 0; dx < 3; ++dx) {
-                for (int dy = 0; dy < 3; ++dy) {
-                    const int nx = i + dx - 1;
-                    const int ny = j + dy - 1;
-                    if (0 <= nx && nx < height && 0 <= ny && ny < width) {
-                        max_val = std::max(max_val, input[at(nx, ny)]);
-                    }
-                }
-            }
-            output[p_index] = max_val;
-        }
-    }
+    static_assert(std::is_same_v<T, float>, "Only float heatmaps can be smoothed.");
+    const auto [channel, height, width] = input.dims();
+
+    hyperpose::parallel_for(channel, [=, &input, &output, &coefficients](const decltype(channel) k)
+    {
+        thread_local std::vector<float> line;
+        recursive_gaussian_blur_2d(height, width, input[k].data(), output[k].data(), coefficients, line);
+    });
 }
 
 template <typename T>
@@ -109,7 +157,13 @@ void same_max_pool_3x3(const ttl::tensor_view<T, 3>& input,
     const auto [channel, height, width] = input.dims();
     hyperpose::parallel_for(channel, [=, &input, &output](const decltype(channel) k)
     {
-        same_max_pool_3x3_2d(height, width, input[k].data(), output[k].data());
+        if constexpr (std::is_same_v<T, float>) {
+            thread_local std::vector<float> column_max;
+            column_max.resize(width);
+            same_max_pool_3x3_2d_simd(height, width, input[k].data(), output[k].data(), column_max.data());
+        } else {
+            same_max_pool_3x3_2d(height, width, input[k].data(), output[k].data());
+        }
     });
 }
 
@@ -140,125 +194,244 @@ struct peak_info {
     point_2d<int> pos;
     float score;
     int id;
+    point_2d<float> refined_pos; // Sub-pixel position, the same as `pos` if the peak is not refined.
+    float level; // The smoothed value of the peak, which is above the threshold it was found with.
 };
 
 template <typename T>
 class peak_finder_t {
 public:
-    peak_finder_t(int channel, int height, int width, int ksize)
-        : channel(channel)
+    // Only the first `n_parts` channels are body parts, the rest (background) is never searched.
+    peak_finder_t(int channel, int n_parts, int height, int width, int ksize,
+        parser::smoothing_method method = parser::smoothing_method::gaussian, double sigma = 3.0)
+        : ksize(ksize)
+        , sigma(sigma)
+        , channel(channel)
+        , n_parts(std::min(channel, n_parts))
         , height(height)
         , width(width)
-        , ksize(ksize)
-        , smoothed_cpu(channel, height, width)
-        , pooled_cpu(channel, height, width)
-        , same_max_pool_3x3_gpu(1, channel, height, width, 3, 3)
+        , smoothing(method)
+        , gaussian(gaussian_kernel(ksize, sigma))
+        , recursive_gaussian(young_van_vliet(sigma))
     {
     }
 
+    // `sparse`: only search the tiles found by the last `find_candidate_tiles` call. (CPU only)
     std::vector<peak_info> find_peak_coords(const ttl::tensor_view<T, 3>& heatmap,
-        float threshold, bool use_gpu)
+        float threshold, bool use_gpu, bool sparse = false)
     {
         TRACE_SCOPE(__func__);
 
-        {
-            TRACE_SCOPE("find_peak_coords::smooth");
-            smooth(heatmap, ttl::ref(smoothed_cpu), ksize);
-        }
+        static_assert(std::is_same_v<T, float>, "Only float heatmaps are supported.");
+        if (use_gpu)
+            return find_peak_coords_gpu(heatmap, threshold);
 
-        if (use_gpu) {
-            TRACE_SCOPE("find_peak_coords::max pooling on GPU");
-            ttl::cuda_tensor<T, 3> pool_input_gpu(channel, height, width),
-                pooled_gpu(channel, height, width);
-            ttl::copy(ttl::ref(pool_input_gpu), ttl::view(smoothed_cpu));
-            // FIXME: pass ttl::tensor_{ref/view}
-            same_max_pool_3x3_gpu(pool_input_gpu.data(), pooled_gpu.data());
-            // cudaDeviceSynchronize();
-            ttl::copy(ttl::ref(pooled_cpu), ttl::view(pooled_gpu));
-        } else {
-            TRACE_SCOPE("find_peak_coords::max pooling on CPU");
-            same_max_pool_3x3(ttl::view(smoothed_cpu), ttl::ref(pooled_cpu));
-        }
+        peaks_by_channel.resize(n_parts);
 
-        using peak_info_list = std::vector<peak_info>;
-        peak_info_list all_peaks;
         {
-            TRACE_SCOPE("find_peak_coords::find all peaks");
-#ifdef HYPERPOSE_PARALLELIZE_FIND_ALL_PEAKS
-            const auto maybe_add_peak_info = [=, &heatmap](auto& all_peaks, const int k, const int i, const int j, const int off)
-#else
-            const auto maybe_add_peak_info = [&](const int k, const int i, const int j, const int off)
-#endif
+            TRACE_SCOPE("find_peak_coords::smooth, pool and threshold");
+            hyperpose::parallel_for(n_parts, [this, threshold, sparse, &heatmap](const int k)
             {
-                if (k < COCO_N_PARTS && //
-                    smoothed_cpu.data()[off] > threshold && smoothed_cpu.data()[off] == pooled_cpu.data()[off]) {
-                    const int idx = all_peaks.size();
-                    all_peaks.push_back(
-                        peak_info{ k, point_2d<int>{ j, i }, heatmap.data()[off], idx });
-                }
-            };
-
-#ifdef HYPERPOSE_PARALLELIZE_FIND_ALL_PEAKS
-            hyperpose::combinable<peak_info_list> peaks_tmp;
-            hyperpose::parallel_for<int>(channel, [=, size=(width*height), &peaks_tmp](const int k)
-            {
-                auto& local_peaks = peaks_tmp.local();
-                int off = size * k;
-#else
-            int off = 0;
-            for (int k = 0; k < channel; ++k)
-            {
-#endif
-                for (int i = 0; i < height; ++i) {
-                    for (int j = 0; j < width; ++j) {
-                        maybe_add_peak_info
-                        (
-#ifdef HYPERPOSE_PARALLELIZE_FIND_ALL_PEAKS
-                            local_peaks,
-#endif
-                            k, i, j, off
-                        );
-                        ++off;
+                thread_local fused_peak_extractor extractor;
+
+                const T* image = heatmap[k].data();
+                auto& peaks = peaks_by_channel[k];
+                peaks.clear();
+                const auto on_peak = [&](const int i, const int j, const float di, const float dj, const float level) {
+                    const auto refined_pos = subpixel ? point_2d<float>{ j + dj, i + di } : point_2d<float>{ float(j), float(i) };
+                    peaks.push_back(peak_info{ k, point_2d<int>{ j, i }, image[i * width + j], -1, refined_pos, level });
+                };
+
+                if (sparse && candidates[k].windows().empty())
+                    return;
+
+                if (smoothing == parser::smoothing_method::recursive_gaussian) {
+                    // The vertical IIR passes need whole columns, so only the pooling and thresholding are fused. In
+                    // sparse mode, the IIR runs on the bounding box of the windows plus a margin, which keeps the
+                    // transients of the cut borders away from the windows. (The peaks are then the same as on the
+                    // whole channel, but for ties of nearly flat peaks.)
+                    thread_local std::vector<float> smoothed, line;
+                    pixel_window region{ 0, height, 0, width };
+                    if (sparse)
+                        region = bounding_window(candidates[k].windows(), 2 * smoothing_radius() + 1, height, width);
+
+                    const int rows = region.row_end - region.row_begin, cols = region.col_end - region.col_begin;
+                    smoothed.resize(static_cast<size_t>(rows) * cols);
+                    recursive_gaussian_blur_2d(rows, cols, image + static_cast<size_t>(region.row_begin) * width + region.col_begin, width,
+                        smoothed.data(), recursive_gaussian, line);
+                    if (sparse) {
+                        for (const auto& window : candidates[k].windows())
+                            extractor.extract_smoothed(height, width, smoothed.data(), region, threshold, window, on_peak);
+                    } else {
+                        extractor.extract_smoothed(height, width, smoothed.data(), threshold, on_peak);
                     }
-                }
-            }
-#ifdef HYPERPOSE_PARALLELIZE_FIND_ALL_PEAKS
-            );
-
-            peaks_tmp.combine_each([&all_peaks](auto& peaks)
-            {
-                all_peaks.reserve(all_peaks.size() + peaks.size());
-                for (auto& peak : peaks)
-                {
-                    peak.id = all_peaks.size();
-                    all_peaks.push_back(std::move(peak));
+                } else if (sparse) {
+                    for (const auto& window : candidates[k].windows())
+                        extractor.extract(height, width, image, gaussian, threshold, window, on_peak);
+                } else {
+                    extractor.extract(height, width, image, gaussian, threshold, on_peak);
                 }
             });
-#endif
         }
-        return all_peaks;
+
+        return gather_peaks();
+    }
+
+    // Sparse mode: find the tiles which may hold a peak above `threshold` from `src_heatmap`, the heatmap before
+    // resizing. Returns false if there is none.
+    bool find_candidate_tiles(const ttl::tensor_view<T, 3>& src_heatmap, float threshold)
+    {
+        TRACE_SCOPE(__func__);
+
+        const auto [src_channel, src_height, src_width] = src_heatmap.dims();
+        const int n_searched = std::min<int>(src_channel, n_parts);
+        candidates.resize(n_searched);
+
+        hyperpose::parallel_for(n_searched, [=, &src_heatmap](const int k)
+        {
+            candidates[k].find(src_heatmap[k].data(), src_height, src_width, height, width, smoothing_radius(), threshold);
+        });
+
+        return std::any_of(candidates.begin(), candidates.end(), [](const auto& c) { return !c.windows().empty(); });
+    }
+
+    // Video mode: search the tiles overlapping `regions_by_part[k]` in channel `k` instead, e.g., the neighbourhoods of
+    // the key points of the previous frame. Returns false if there is none.
+    bool find_candidate_tiles_around(const std::vector<std::vector<pixel_window>>& regions_by_part)
+    {
+        TRACE_SCOPE(__func__);
+
+        candidates.resize(n_parts);
+        bool any = false;
+        for (int k = 0; k < n_parts; ++k)
+            any |= candidates[k].around(regions_by_part[k], height, width);
+        return any;
+    }
+
+    // Only search the candidate tiles (of the last `find_candidate_tiles*` call) within `regions`, e.g., the regions of
+    // interest. Returns false if there is none left.
+    bool clip_candidate_tiles(const std::vector<pixel_window>& regions)
+    {
+        bool any = false;
+        for (auto& c : candidates)
+            any |= c.clip(regions);
+        return any;
     }
 
     std::vector<std::vector<int>>
     group_by(const std::vector<peak_info>& all_peaks)
     {
-        std::vector<std::vector<int>> peak_ids_by_channel(COCO_N_PARTS);
+        std::vector<std::vector<int>> peak_ids_by_channel(n_parts);
         for (const auto& pi : all_peaks) {
             peak_ids_by_channel[pi.part_id].push_back(pi.id);
         }
         return peak_ids_by_channel;
     }
 
+    void set_smoothing_method(parser::smoothing_method method) { smoothing = method; }
+
+    // Refine the peaks (`peak_info::refined_pos`) to sub-pixel accuracy. (CPU only)
+    void set_subpixel_refinement(bool refine) { subpixel = refine; }
+
+    cv::Size size() const { return cv::Size(width, height); }
+
+    // How far the smoothing reaches: the kernel radius, or the distance the recursive filter's response fades in.
+    int smoothing_radius() const
+    {
+        return smoothing == parser::smoothing_method::recursive_gaussian ? static_cast<int>(std::ceil(4 * sigma)) : ksize / 2;
+    }
+
     const int ksize;
+    const double sigma;
 
 private:
+    // Concatenate the per-channel peaks in channel order and number them.
+    std::vector<peak_info> gather_peaks() const
+    {
+        TRACE_SCOPE("find_peak_coords::gather peaks");
+
+        size_t n_peaks = 0;
+        for (const auto& peaks : peaks_by_channel)
+            n_peaks += peaks.size();
+
+        std::vector<peak_info> all_peaks;
+        all_peaks.reserve(n_peaks);
+        for (const auto& peaks : peaks_by_channel)
+            for (const auto& peak : peaks) {
+                all_peaks.push_back(peak);
+                all_peaks.back().id = all_peaks.size() - 1;
+            }
+        return all_peaks;
+    }
+
+    // Unfused path: the max pooling runs on the GPU, so the smoothed and pooled maps are materialized.
+    std::vector<peak_info> find_peak_coords_gpu(const ttl::tensor_view<T, 3>& heatmap, float threshold)
+    {
+        if (!gpu_buffers)
+            gpu_buffers = std::make_unique<gpu_buffers_t>(channel, height, width);
+        auto& [smoothed_cpu, pooled_cpu, same_max_pool_3x3_gpu] = *gpu_buffers;
+
+        {
+            TRACE_SCOPE("find_peak_coords::smooth");
+            if (smoothing == parser::smoothing_method::recursive_gaussian)
+                smooth_recursive(heatmap, ttl::ref(smoothed_cpu), recursive_gaussian);
+            else
+                smooth(heatmap, ttl::ref(smoothed_cpu), gaussian);
+        }
+
+        {
+            TRACE_SCOPE("find_peak_coords::max pooling on GPU");
+            ttl::cuda_tensor<T, 3> pool_input_gpu(channel, height, width),
+                pooled_gpu(channel, height, width);
+            ttl::copy(ttl::ref(pool_input_gpu), ttl::view(smoothed_cpu));
+            // FIXME: pass ttl::tensor_{ref/view}
+            same_max_pool_3x3_gpu(pool_input_gpu.data(), pooled_gpu.data());
+            // cudaDeviceSynchronize();
+            ttl::copy(ttl::ref(pooled_cpu), ttl::view(pooled_gpu));
+        }
+
+        TRACE_SCOPE("find_peak_coords::find all peaks");
+        peaks_by_channel.resize(n_parts);
+        for (int k = 0; k < n_parts; ++k) {
+            auto& peaks = peaks_by_channel[k];
+            peaks.clear();
+            const int off = k * height * width;
+            for (int i = 0; i < height; ++i)
+                for (int j = 0; j < width; ++j) {
+                    const int p = off + i * width + j;
+                    if (smoothed_cpu.data()[p] > threshold && smoothed_cpu.data()[p] == pooled_cpu.data()[p])
+                        peaks.push_back(peak_info{ k, point_2d<int>{ j, i }, heatmap.data()[p], -1, point_2d<float>{ float(j), float(i) }, smoothed_cpu.data()[p] });
+                }
+        }
+        return gather_peaks();
+    }
+
     const int channel;
+    const int n_parts;
     const int height;
     const int width;
 
-    ttl::tensor<T, 3> smoothed_cpu;
-    ttl::tensor<T, 3> pooled_cpu;
+    parser::smoothing_method smoothing;
+    bool subpixel = false;
+    const std::vector<float> gaussian;
+    const recursive_gaussian_coefficients recursive_gaussian;
+
+    std::vector<std::vector<peak_info>> peaks_by_channel; // Reused across images, so they're allocated once.
+
+    std::vector<candidate_tiles> candidates;
+
+    struct gpu_buffers_t {
+        gpu_buffers_t(int channel, int height, int width)
+            : smoothed_cpu(channel, height, width)
+            , pooled_cpu(channel, height, width)
+            , same_max_pool_3x3_gpu(1, channel, height, width, 3, 3)
+        {
+        }
 
-    Pool_NCHW_PaddingSame_Max<T> same_max_pool_3x3_gpu;
+        ttl::tensor<T, 3> smoothed_cpu;
+        ttl::tensor<T, 3> pooled_cpu;
+        Pool_NCHW_PaddingSame_Max<T> same_max_pool_3x3_gpu;
+    };
+    std::unique_ptr<gpu_buffers_t> gpu_buffers; // Only allocated if the GPU path is used.
 };
 }
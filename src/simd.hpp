@@ -0,0 +1,168 @@
+#pragma once
+
+// A thin wrapper over the SIMD instruction sets used by the CPU post-processing kernels.
+// Exactly one `float_v` implementation is selected at compile time (`-march=native` picks the widest available one).
+// Kernels are written against `float_v` and must handle the `n % float_v::width` tail with scalar code.
+// `zip_lo(a, b)` / `zip_hi(a, b)` interleave the first / second halves of `a` and `b`: a0 b0 a1 b1 ...
+// `greater(a, b)` is 1.0f in the lanes where a > b, 0.0f elsewhere, so that it can be summed up as a counter.
+// `float_v::load(const std::uint16_t*)` and `to_float(std::uint16_t)` widen FP16 (IEEE binary16 bits) values, with
+// F16C / NEON conversion instructions when available.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define HYPERPOSE_SIMD_AVX2
+#elif defined(__SSE4_1__)
+    #include <smmintrin.h>
+    #define HYPERPOSE_SIMD_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define HYPERPOSE_SIMD_NEON
+#endif
+
+#if defined(__F16C__)
+    #include <immintrin.h>
+#endif
+
+namespace hyperpose {
+
+namespace simd {
+
+    inline float to_float(const float x) { return x; }
+
+    inline float to_float(const std::uint16_t h)
+    {
+#if defined(__F16C__)
+        return _cvtsh_ss(h);
+#elif defined(HYPERPOSE_SIMD_NEON)
+        return vgetq_lane_f32(vcvt_f32_f16(vreinterpret_f16_u16(vdup_n_u16(h))), 0);
+#else
+        const std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+        const std::uint32_t exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+        std::uint32_t bits;
+        if (exponent == 0x1f) // Inf / NaN
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        else if (exponent != 0)
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        else { // Zero / subnormal: mantissa x 2^-24, which is exact in FP32.
+            const float magnitude = mantissa * (1.f / (1 << 24));
+            std::memcpy(&bits, &magnitude, sizeof(bits));
+            bits |= sign;
+        }
+        float x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+#endif
+    }
+
+#if defined(HYPERPOSE_SIMD_AVX2)
+    constexpr const char* isa = "AVX2";
+
+    struct float_v {
+        static constexpr int width = 8;
+        __m256 v;
+
+        static float_v load(const float* p) { return { _mm256_loadu_ps(p) }; }
+        static float_v load(const std::uint16_t* p)
+        {
+#if defined(__F16C__)
+            return { _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) };
+#else
+            float x[width];
+            std::transform(p, p + width, x, [](std::uint16_t h) { return to_float(h); });
+            return load(x);
+#endif
+        }
+        static float_v broadcast(float x) { return { _mm256_set1_ps(x) }; }
+        void store(float* p) const { _mm256_storeu_ps(p, v); }
+    };
+
+    inline float_v max(float_v a, float_v b) { return { _mm256_max_ps(a.v, b.v) }; }
+    inline float_v min(float_v a, float_v b) { return { _mm256_min_ps(a.v, b.v) }; }
+    inline float_v operator+(float_v a, float_v b) { return { _mm256_add_ps(a.v, b.v) }; }
+    inline float_v operator-(float_v a, float_v b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    inline float_v operator*(float_v a, float_v b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    // Interleaving across the two 128-bit lanes.
+    inline float_v zip_lo(float_v a, float_v b) { return { _mm256_permute2f128_ps(_mm256_unpacklo_ps(a.v, b.v), _mm256_unpackhi_ps(a.v, b.v), 0x20) }; }
+    inline float_v zip_hi(float_v a, float_v b) { return { _mm256_permute2f128_ps(_mm256_unpacklo_ps(a.v, b.v), _mm256_unpackhi_ps(a.v, b.v), 0x31) }; }
+    inline float_v greater(float_v a, float_v b) { return { _mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ), _mm256_set1_ps(1.f)) }; }
+#elif defined(HYPERPOSE_SIMD_SSE)
+    constexpr const char* isa = "SSE4.1";
+
+    struct float_v {
+        static constexpr int width = 4;
+        __m128 v;
+
+        static float_v load(const float* p) { return { _mm_loadu_ps(p) }; }
+        static float_v load(const std::uint16_t* p)
+        {
+#if defined(__F16C__)
+            return { _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))) };
+#else
+            float x[width];
+            std::transform(p, p + width, x, [](std::uint16_t h) { return to_float(h); });
+            return load(x);
+#endif
+        }
+        static float_v broadcast(float x) { return { _mm_set1_ps(x) }; }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+    };
+
+    inline float_v max(float_v a, float_v b) { return { _mm_max_ps(a.v, b.v) }; }
+    inline float_v min(float_v a, float_v b) { return { _mm_min_ps(a.v, b.v) }; }
+    inline float_v operator+(float_v a, float_v b) { return { _mm_add_ps(a.v, b.v) }; }
+    inline float_v operator-(float_v a, float_v b) { return { _mm_sub_ps(a.v, b.v) }; }
+    inline float_v operator*(float_v a, float_v b) { return { _mm_mul_ps(a.v, b.v) }; }
+    inline float_v zip_lo(float_v a, float_v b) { return { _mm_unpacklo_ps(a.v, b.v) }; }
+    inline float_v zip_hi(float_v a, float_v b) { return { _mm_unpackhi_ps(a.v, b.v) }; }
+    inline float_v greater(float_v a, float_v b) { return { _mm_and_ps(_mm_cmpgt_ps(a.v, b.v), _mm_set1_ps(1.f)) }; }
+#elif defined(HYPERPOSE_SIMD_NEON)
+    constexpr const char* isa = "NEON";
+
+    struct float_v {
+        static constexpr int width = 4;
+        float32x4_t v;
+
+        static float_v load(const float* p) { return { vld1q_f32(p) }; }
+        static float_v load(const std::uint16_t* p) { return { vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p))) }; }
+        static float_v broadcast(float x) { return { vdupq_n_f32(x) }; }
+        void store(float* p) const { vst1q_f32(p, v); }
+    };
+
+    inline float_v max(float_v a, float_v b) { return { vmaxq_f32(a.v, b.v) }; }
+    inline float_v min(float_v a, float_v b) { return { vminq_f32(a.v, b.v) }; }
+    inline float_v operator+(float_v a, float_v b) { return { vaddq_f32(a.v, b.v) }; }
+    inline float_v operator-(float_v a, float_v b) { return { vsubq_f32(a.v, b.v) }; }
+    inline float_v operator*(float_v a, float_v b) { return { vmulq_f32(a.v, b.v) }; }
+    inline float_v zip_lo(float_v a, float_v b) { return { vzip1q_f32(a.v, b.v) }; }
+    inline float_v zip_hi(float_v a, float_v b) { return { vzip2q_f32(a.v, b.v) }; }
+    inline float_v greater(float_v a, float_v b) { return { vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(a.v, b.v), vreinterpretq_u32_f32(vdupq_n_f32(1.f)))) }; }
+#else
+    constexpr const char* isa = "scalar";
+
+    struct float_v {
+        static constexpr int width = 1;
+        float v;
+
+        static float_v load(const float* p) { return { *p }; }
+        static float_v load(const std::uint16_t* p) { return { to_float(*p) }; }
+        static float_v broadcast(float x) { return { x }; }
+        void store(float* p) const { *p = v; }
+    };
+
+    inline float_v max(float_v a, float_v b) { return { std::max(a.v, b.v) }; }
+    inline float_v min(float_v a, float_v b) { return { std::min(a.v, b.v) }; }
+    inline float_v operator+(float_v a, float_v b) { return { a.v + b.v }; }
+    inline float_v operator-(float_v a, float_v b) { return { a.v - b.v }; }
+    inline float_v operator*(float_v a, float_v b) { return { a.v * b.v }; }
+    inline float_v zip_lo(float_v a, float_v) { return a; }
+    inline float_v zip_hi(float_v, float_v b) { return b; }
+    inline float_v greater(float_v a, float_v b) { return { a.v > b.v ? 1.f : 0.f }; }
+#endif
+
+} // namespace simd
+
+} // namespace hyperpose
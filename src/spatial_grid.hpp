@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace hyperpose {
+
+// Uniform grid over 2D points for fixed radius neighbour queries.
+// Points are bucketed by counting sort, so building is O(n + cells) and a query only visits the 3x3 cells around it
+// when the cell size is not smaller than the radius.
+class spatial_grid {
+public:
+    // `cell_size` (> 0) is usually the query radius. The coordinates are referenced, not copied.
+    void build(const float* xs, const float* ys, const size_t n, const float cell_size)
+    {
+        m_xs = xs;
+        m_ys = ys;
+        m_cells.clear();
+        m_items.resize(n);
+        if (n == 0)
+            return;
+
+        const auto [min_x, max_x] = std::minmax_element(xs, xs + n);
+        const auto [min_y, max_y] = std::minmax_element(ys, ys + n);
+        m_origin_x = *min_x;
+        m_origin_y = *min_y;
+        // At most MAX_CELLS_PER_SIDE x MAX_CELLS_PER_SIDE cells however small `cell_size` is.
+        m_cell_size = std::max(cell_size, std::max(*max_x - *min_x, *max_y - *min_y) / MAX_CELLS_PER_SIDE);
+        m_cols = cell_of(*max_x - m_origin_x) + 1;
+        m_rows = cell_of(*max_y - m_origin_y) + 1;
+
+        // m_cells[c] is the beginning of cell `c` in `m_items`.
+        m_cells.assign(static_cast<size_t>(m_cols) * m_rows + 1, 0);
+        for (size_t i = 0; i < n; ++i)
+            ++m_cells[cell_id(xs[i], ys[i]) + 1];
+        for (size_t c = 1; c < m_cells.size(); ++c)
+            m_cells[c] += m_cells[c - 1];
+        m_fill.assign(m_cells.begin(), m_cells.end() - 1);
+        for (size_t i = 0; i < n; ++i)
+            m_items[m_fill[cell_id(xs[i], ys[i])]++] = i;
+    }
+
+    // Appends the indices of the points within `radius` of (x, y) to `out`, in ascending order.
+    void query(const float x, const float y, const float radius, std::vector<size_t>& out) const
+    {
+        const size_t old_size = out.size();
+        if (m_cells.empty())
+            return;
+
+        const int col_begin = std::max(0, cell_of(x - radius - m_origin_x)), col_end = std::min(m_cols - 1, cell_of(x + radius - m_origin_x));
+        const int row_begin = std::max(0, cell_of(y - radius - m_origin_y)), row_end = std::min(m_rows - 1, cell_of(y + radius - m_origin_y));
+        for (int row = row_begin; row <= row_end; ++row)
+            for (int col = col_begin; col <= col_end; ++col) {
+                const size_t c = static_cast<size_t>(row) * m_cols + col;
+                for (size_t k = m_cells[c]; k < m_cells[c + 1]; ++k) {
+                    const size_t i = m_items[k];
+                    const float dx = m_xs[i] - x, dy = m_ys[i] - y;
+                    if (dx * dx + dy * dy <= radius * radius)
+                        out.push_back(i);
+                }
+            }
+        std::sort(out.begin() + old_size, out.end());
+    }
+
+private:
+    static constexpr float MAX_CELLS_PER_SIDE = 256;
+
+    int cell_of(const float offset) const { return static_cast<int>(std::floor(offset / m_cell_size)); }
+    size_t cell_id(const float x, const float y) const { return static_cast<size_t>(cell_of(y - m_origin_y)) * m_cols + cell_of(x - m_origin_x); }
+
+    const float *m_xs = nullptr, *m_ys = nullptr;
+    float m_cell_size = 1, m_origin_x = 0, m_origin_y = 0;
+    int m_cols = 0, m_rows = 0;
+    std::vector<size_t> m_cells, m_fill, m_items;
+};
+
+} // namespace hyperpose
@@ -34,6 +34,19 @@ size_t basic_stream_manager::processed_num() const noexcept
     return m_ingest;
 }
 
+double basic_stream_manager::first_frame_latency() const noexcept
+{
+    return m_first_frame_latency;
+}
+
+void basic_stream_manager::report_first_frame()
+{
+    if (m_first_frame_latency > 0)
+        return;
+    m_first_frame_latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_first_input_time).count();
+    info("First frame latency: ", m_first_frame_latency, " ms\n");
+}
+
 void basic_stream_manager::read_from(cv::VideoCapture& cap)
 {
     if (-1 == cap.get(cv::CAP_PROP_FRAME_COUNT))
@@ -77,6 +90,8 @@ void basic_stream_manager::resize_from_inputs(cv::Size size)
             break;
 
         auto inputs = m_input_queue.dump_all();
+        if (m_first_input_time == std::chrono::steady_clock::time_point{})
+            m_first_input_time = std::chrono::steady_clock::now();
 
         std::vector<cv::Mat> after_resize_mats;
         after_resize_mats.reserve(inputs.size());
@@ -133,6 +148,7 @@ void basic_stream_manager::write_to(cv::VideoWriter& writer)
                     draw_human(raw_image, pose);
                 }
                 writer << raw_image;
+                report_first_frame();
                 --m_remaining_num;
             }
 
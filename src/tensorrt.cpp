@@ -103,6 +103,18 @@ namespace dnn {
         return ret;
     }
 
+    // Opt-in: FP16 kernels and FP16 output bindings, so that the outputs take half the memory(and bandwidth) on the host.
+    static void set_half_outputs(nvinfer1::INetworkDefinition& network, nvinfer1::IBuilderConfig& config, bool half_outputs)
+    {
+        if (!half_outputs)
+            return;
+
+        info("Building the engine in FP16 mode with FP16 outputs.\n");
+        config.setFlag(nvinfer1::BuilderFlag::kFP16);
+        for (auto i : ttl::range(network.getNbOutputs()))
+            network.getOutput(i)->setType(nvinfer1::DataType::kHALF);
+    }
+
     struct tensorrt::cuda_dep {
         using cuda_buffer_t = ttl::cuda_tensor<char, 2>; // [batch_size, data_size]
 
@@ -122,7 +134,7 @@ namespace dnn {
     create_uff_engine(const std::string& model_file, cv::Size input_size,
         const std::string& input_name,
         const std::vector<std::string>& output_names, int max_batch_size,
-        nvinfer1::DataType dtype)
+        nvinfer1::DataType dtype, bool half_outputs)
     {
         TRACE_SCOPE(__func__);
         destroy_ptr<nvuffparser::IUffParser> parser(nvuffparser::createUffParser());
@@ -149,6 +161,7 @@ namespace dnn {
 
         destroy_ptr<nvinfer1::IBuilderConfig> config(builder->createBuilderConfig());
         config->setMaxWorkspaceSize(1ull << 30);
+        set_half_outputs(*network, *config, half_outputs);
         auto engine = builder->buildEngineWithConfig(*network, *config);
 
         if (nullptr == engine) {
@@ -160,7 +173,7 @@ namespace dnn {
     }
 
     static nvinfer1::ICudaEngine*
-    create_onnx_engine(const std::string& model_file, int max_batch_size, nvinfer1::DataType dtype, cv::Size size)
+    create_onnx_engine(const std::string& model_file, int max_batch_size, nvinfer1::DataType dtype, cv::Size size, bool half_outputs)
     {
         TRACE_SCOPE(__func__);
         destroy_ptr<nvinfer1::IBuilder> builder(nvinfer1::createInferBuilder(gLogger));
@@ -181,6 +194,7 @@ namespace dnn {
 
         destroy_ptr<nvinfer1::IBuilderConfig> config(builder->createBuilderConfig());
         config->setMaxWorkspaceSize(1ull << 20); // TODO: A better way to set the workspace.
+        set_half_outputs(*network, *config, half_outputs);
 
         builder->setMaxBatchSize(max_batch_size);
 
@@ -317,14 +331,14 @@ namespace dnn {
 
     tensorrt::tensorrt(const uff& uff_model, cv::Size input_size,
         int max_batch_size, bool keep_ratio, data_type dtype, double factor,
-        bool flip_rgb)
+        bool flip_rgb, bool half_outputs)
         : m_inp_size(input_size)
         , m_flip_rgb(flip_rgb)
         , m_max_batch_size(max_batch_size)
         , m_keep_ratio(keep_ratio)
         , m_factor(factor)
         , m_cuda_dep(std::make_unique<cuda_dep>(create_uff_engine(uff_model.model_path, input_size, uff_model.input_name, uff_model.output_names,
-              max_batch_size, static_cast<nvinfer1::DataType>(dtype.val))))
+              max_batch_size, static_cast<nvinfer1::DataType>(dtype.val), half_outputs)))
     {
         _create_binding_buffers();
     }
@@ -344,13 +358,13 @@ namespace dnn {
 
     tensorrt::tensorrt(const onnx& onnx_model, cv::Size input_size,
         int max_batch_size, bool keep_ratio, data_type dtype, double factor,
-        bool flip_rgb)
+        bool flip_rgb, bool half_outputs)
         : m_inp_size(input_size)
         , m_flip_rgb(flip_rgb)
         , m_max_batch_size(max_batch_size)
         , m_keep_ratio(keep_ratio)
         , m_factor(factor)
-        , m_cuda_dep(std::make_unique<cuda_dep>(create_onnx_engine(onnx_model.model_path, max_batch_size, static_cast<nvinfer1::DataType>(dtype.val), input_size)))
+        , m_cuda_dep(std::make_unique<cuda_dep>(create_onnx_engine(onnx_model.model_path, max_batch_size, static_cast<nvinfer1::DataType>(dtype.val), input_size, half_outputs)))
     {
         _create_binding_buffers();
     }
@@ -418,6 +432,8 @@ namespace dnn {
                 for (size_t k = start_index; k < out_dims.nbDims; ++k)
                     non_batch_shape.push_back(out_dims.d[k]);
 
+                const data_type dtype = static_cast<int>(m_cuda_dep->m_engine->getBindingDataType(i));
+
                 info("Get Inference Result: ", name, ": ", to_string(out_dims), '\n');
 
                 for (auto j : ttl::range(batch_size)) {
@@ -425,7 +441,7 @@ namespace dnn {
                     std::unique_ptr<char[]> data{ new char[slice_size] };
 
                     ttl::copy(ttl::vector_ref<char>(data.get(), ttl::shape<1>(slice_size)), ttl::view(buffer[j]));
-                    ret[j].emplace_back(name, std::move(data), non_batch_shape);
+                    ret[j].emplace_back(name, std::move(data), non_batch_shape, dtype);
                 }
             }
         }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+
+namespace hyperpose {
+
+// The time left to parse an image.
+class deadline {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Starts the clock. `budget_ms` <= 0 means no deadline.
+    void start(const double budget_ms)
+    {
+        m_budget_ms = budget_ms;
+        if (enabled())
+            m_start = clock::now();
+    }
+
+    bool enabled() const { return m_budget_ms > 0; }
+
+    double elapsed_ms() const { return std::chrono::duration<double, std::milli>(clock::now() - m_start).count(); }
+
+    double remaining_ms() const { return m_budget_ms - elapsed_ms(); }
+
+private:
+    double m_budget_ms = 0;
+    clock::time_point m_start;
+};
+
+// Predicts the time of a stage from its amount of work (in any unit), with the time per unit measured on the previous
+// images. The measurements are averaged exponentially, so the prediction follows the load of the machine.
+// `ms_per_unit` is the state of the model (0 until the first measurement), which the caller keeps across images.
+struct cost_model {
+    double& ms_per_unit;
+
+    bool calibrated() const { return ms_per_unit > 0; }
+
+    double predict_ms(const double units) const { return units * ms_per_unit; }
+
+    void update(const double units, const double ms)
+    {
+        // Small stages are dominated by fixed overheads, which would overestimate the time per unit.
+        if (units < MIN_UNITS)
+            return;
+        const double sample = ms / units;
+        ms_per_unit = calibrated() ? (1 - SMOOTHING) * ms_per_unit + SMOOTHING * sample : sample;
+    }
+
+    static constexpr double MIN_UNITS = 1000;
+    static constexpr double SMOOTHING = 0.25;
+};
+
+} // namespace hyperpose
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+#include "simd.hpp"
+
+namespace hyperpose {
+
+// Stores each lane of `v` `Factor` times, `Factor` is a power of 2.
+template <int Factor>
+void store_repeated(const simd::float_v v, float* out)
+{
+    if constexpr (Factor == 1) {
+        v.store(out);
+    } else {
+        store_repeated<Factor / 2>(zip_lo(v, v), out);
+        store_repeated<Factor / 2>(zip_hi(v, v), out + Factor / 2 * simd::float_v::width);
+    }
+}
+
+// out[j * Factor + k] = in[j], for k in [0, Factor)
+// `In` is float or std::uint16_t (FP16), which is widened on the fly.
+template <int Factor, typename In>
+void repeat_row(const In* in, float* out, const int n)
+{
+    using simd::float_v;
+
+    int j = 0;
+    for (; j + float_v::width <= n; j += float_v::width)
+        store_repeated<Factor>(float_v::load(in + j), out + j * Factor);
+    for (; j < n; ++j)
+        std::fill_n(out + j * Factor, Factor, simd::to_float(in[j]));
+}
+
+template <typename In>
+void repeat_row(const In* in, float* out, const int n, const int factor)
+{
+    switch (factor) {
+    case 1:
+        repeat_row<1>(in, out, n);
+        break;
+    case 2:
+        repeat_row<2>(in, out, n);
+        break;
+    case 4:
+        repeat_row<4>(in, out, n);
+        break;
+    case 8:
+        repeat_row<8>(in, out, n);
+        break;
+    default:
+        for (int j = 0; j < n; ++j)
+            std::fill_n(out + j * factor, factor, simd::to_float(in[j]));
+    }
+}
+
+// Upsampling by integer factors: out[y][x] = in[y / factor_y][x / factor_x].
+// For integer factors this is exactly what cv::resize(INTER_AREA) computes.
+template <typename In>
+void replicate_upsample_2d(const int height, const int width, const In* input, float* output,
+    const int factor_y, const int factor_x)
+{
+    const size_t out_width = static_cast<size_t>(width) * factor_x;
+    for (int y = 0; y < height; ++y) {
+        float* out = output + static_cast<size_t>(y) * factor_y * out_width;
+        repeat_row(input + static_cast<size_t>(y) * width, out, width, factor_x);
+        for (int i = 1; i < factor_y; ++i)
+            std::memcpy(out + i * out_width, out, out_width * sizeof(float));
+    }
+}
+
+} // namespace hyperpose
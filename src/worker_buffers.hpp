@@ -0,0 +1,37 @@
+#pragma once
+
+#include <hyperpose/utility/combinable.hpp>
+#include <memory>
+#include <vector>
+
+namespace hyperpose {
+
+// The buffers of the threads running a `hyperpose::parallel_for`, so that they grow with the number of threads instead
+// of the number of iterations. Each thread keeps the buffers it has released, and an iteration checks one out for its
+// whole run: while a thread waits in a nested `parallel_for`, it may run another iteration of the outer one (work
+// stealing), which then gets other buffers.
+template <typename T>
+class worker_buffers {
+public:
+    // Calls `fn(T&)` with buffers of the calling thread, which are allocated on its first use.
+    template <typename Function>
+    void with_local(Function&& fn)
+    {
+        auto& released = m_released.local();
+        std::unique_ptr<T> buffers;
+        if (released.empty())
+            buffers = std::make_unique<T>();
+        else {
+            buffers = std::move(released.back());
+            released.pop_back();
+        }
+
+        fn(*buffers);
+        released.push_back(std::move(buffers));
+    }
+
+private:
+    combinable<std::vector<std::unique_ptr<T>>> m_released;
+};
+
+} // namespace hyperpose